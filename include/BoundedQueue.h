@@ -0,0 +1,112 @@
+/*
+ * BoundedQueue.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: Ulisse Bordignon, Nicola Chinellato
+ */
+
+#ifndef BOUNDEDQUEUE_H_
+#define BOUNDEDQUEUE_H_
+
+#include <stddef.h>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+namespace nl_uu_science_gmt
+{
+
+/**
+ * Blocking FIFO queue with a maximum size, to hand work from one thread to the next.
+ * Once closed, push() fails and pop() fails as soon as the queue is empty.
+ */
+template<typename T>
+class BoundedQueue
+{
+	std::deque<T> _items;
+	size_t _capacity;
+	bool _closed;
+
+	std::mutex _mutex;
+	std::condition_variable _not_empty;
+	std::condition_variable _not_full;
+
+public:
+	BoundedQueue(size_t capacity) :
+			_capacity(capacity), _closed(false)
+	{
+	}
+
+	/**
+	 * Append an item, waits while the queue is full, returns false if the queue is closed
+	 */
+	bool push(const T &item)
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+		_not_full.wait(lock, [this]
+		{	return _closed || _items.size() < _capacity;});
+		if (_closed) return false;
+
+		_items.push_back(item);
+		_not_empty.notify_one();
+		return true;
+	}
+
+	/**
+	 * Take the oldest item, waits while the queue is empty, returns false if the queue is closed and empty
+	 */
+	bool pop(T &item)
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+		_not_empty.wait(lock, [this]
+		{	return _closed || !_items.empty();});
+		if (_items.empty()) return false;
+
+		item = _items.front();
+		_items.pop_front();
+		_not_full.notify_one();
+		return true;
+	}
+
+	/**
+	 * Take the oldest item if there is one
+	 */
+	bool tryPop(T &item)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		if (_items.empty()) return false;
+
+		item = _items.front();
+		_items.pop_front();
+		_not_full.notify_one();
+		return true;
+	}
+
+	void close()
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_closed = true;
+		_not_empty.notify_all();
+		_not_full.notify_all();
+	}
+
+	/**
+	 * Empty the queue and accept items again
+	 */
+	void reset()
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_items.clear();
+		_closed = false;
+	}
+
+	size_t size()
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		return _items.size();
+	}
+};
+
+} /* namespace nl_uu_science_gmt */
+
+#endif /* BOUNDEDQUEUE_H_ */
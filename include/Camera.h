@@ -9,9 +9,17 @@
 #define CAMERA_H_
 
 #include <opencv2/opencv.hpp>
+#include <stdint.h>
+#include <condition_variable>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 
+#include "ForegroundKernel.h"
+#include "FrameCache.h"
+#include "VideoIndex.h"
+
 namespace nl_uu_science_gmt
 {
 
@@ -19,18 +27,19 @@ namespace nl_uu_science_gmt
 
 class Camera
 {
-	static std::vector<cv::Point>* _BoardCorners;  // marked checkerboard corners
-
 	bool _initialized;
 
 	const std::string _data_path;
 	const std::string _cam_prop;
 	const int _id;
 
-	std::vector<cv::Mat> _bg_hsv_channels;
+	cv::Mat _bg_hsv;  // background in interleaved (H, S, V, 0) pixels
+	ForegroundKernel::BackgroundModel _bg_model;  // running background, starts at _bg_hsv
 	cv::Mat _foreground_image;
 
 	cv::VideoCapture _video;
+	VideoIndex _index;  // frame count and keyframes of the video
+	int _position;      // next frame _video decodes
 
 	cv::Size _plane_size;
 	long _frames;
@@ -40,6 +49,12 @@ class Camera
 
 	float _fx, _fy, _px, _py;
 
+	float _extrinsics[12];  // row-major [R|t], world to camera coordinates
+	float _projection[12];  // row-major K[R|t], world to pixel coordinates without distortion
+	float _distortion[8];   // k1, k2, p1, p2, k3, k4, k5, k6 (zero padded)
+	bool _distorted;        // distortion shifts some pixel by a noticeable amount
+	bool _cv_distortion;    // more coefficients than _distortion holds, project with OpenCV
+
 	cv::Mat _rt;
 	cv::Mat _inverse_rt;
 
@@ -48,9 +63,33 @@ class Camera
 	std::vector<cv::Point3f> _camera_floor; // three points that are the projection of the camera itself to the ground floor view
 
 	cv::Mat _frame;
+	int _frame_number;    // frame number of _frame
+	int _stream_frame;    // frame number of the last frame read from the video
+	bool _reposition;     // the next frame doesn't follow _stream_frame
+	FrameCache* _cache;   // decoded frames shared by all cameras, may be NULL
+
+	// Read-ahead: once started, a decode thread keeps up to _prefetch decoded frames in a ring of recycled buffers
+	std::thread _decoder;
+	std::mutex _decode_mutex;
+	std::condition_variable _decode_condition;
+	int _prefetch;
+	std::vector<cv::Mat> _ring;
+	std::vector<int> _ring_frames;  // frame number of each ring slot
+	size_t _ring_head, _ring_count;
+	unsigned int _ring_generation;  // incremented on every seek, frames decoded before it are dropped
+	int _seek_frame;                // pending seek for the decode thread, -1 if none
+	bool _ring_end;                 // the decode thread reached the end of the video
+	bool _decode_stop;
+	bool _frame_requested;
+
+	void decode();
+	void seekVideo(int);
+	void positionVideo(int);
+	int popVideoFrame(cv::Mat &);
 
 	static void onMouse(int, int, int, int, void*);
 	void initCamLoc();
+	void initProjection();
 	inline void camPtInWorld();
 
 	cv::Point3f ptToW3D(const cv::Point &);
@@ -63,13 +102,63 @@ public:
 	bool initialize();
 
 	cv::Mat& advanceVideoFrame();
+	int readVideoFrame(cv::Mat &);
+	void swapFrame(cv::Mat &, int);
 	cv::Mat& getVideoFrame(int);
 	void setVideoFrame(int);
 
+	void startDecoder();
+	void requestVideoFrame(int = -1);
+	cv::Mat& waitVideoFrame();
+
 	static bool detExtrinsics(const std::string &, const std::string &, const std::string &, const std::string &);
 
 	static cv::Point projectOnView(const cv::Point3f &, const cv::Mat &, const cv::Mat &, const cv::Mat &, const cv::Mat &);
 	cv::Point projectOnView(const cv::Point3f &);
+	void projectOnView(const std::vector<cv::Point3f> &, std::vector<cv::Point2f> &) const;
+	void projectOnView(const cv::Point3f*, size_t, cv::Point2f*) const;
+
+	uint64_t getCalibrationHash() const;
+
+	/**
+	 * Project a world point with the fused projection matrix, ignoring distortion
+	 */
+	inline cv::Point2f projectPinhole(const cv::Point3f &p) const
+	{
+		const float* P = _projection;
+		const float w = P[8] * p.x + P[9] * p.y + P[10] * p.z + P[11];
+		const float iw = w != 0 ? 1.f / w : 1.f;
+		return cv::Point2f((P[0] * p.x + P[1] * p.y + P[2] * p.z + P[3]) * iw,
+				(P[4] * p.x + P[5] * p.y + P[6] * p.z + P[7]) * iw);
+	}
+
+	/**
+	 * Project a world point with the extrinsics, radial/tangential distortion and intrinsics (as cv::projectPoints)
+	 */
+	inline cv::Point2f projectDistorted(const cv::Point3f &p) const
+	{
+		const float* E = _extrinsics;
+		const float* k = _distortion;
+		const float z = E[8] * p.x + E[9] * p.y + E[10] * p.z + E[11];
+		const float iz = z != 0 ? 1.f / z : 1.f;
+		const float x = (E[0] * p.x + E[1] * p.y + E[2] * p.z + E[3]) * iz;
+		const float y = (E[4] * p.x + E[5] * p.y + E[6] * p.z + E[7]) * iz;
+
+		const float r2 = x * x + y * y;
+		const float r4 = r2 * r2;
+		const float r6 = r4 * r2;
+		const float a1 = 2 * x * y;
+		const float radial = (1 + k[0] * r2 + k[1] * r4 + k[4] * r6) / (1 + k[5] * r2 + k[6] * r4 + k[7] * r6);
+		const float xd = x * radial + k[2] * a1 + k[3] * (r2 + 2 * x * x);
+		const float yd = y * radial + k[2] * (r2 + 2 * y * y) + k[3] * a1;
+
+		return cv::Point2f(xd * _fx + _px, yd * _fy + _py);
+	}
+
+	bool isDistorted() const
+	{
+		return _distorted;
+	}
 
 	const std::string& getCamPropertiesFile() const
 	{
@@ -101,9 +190,42 @@ public:
 		return _frames;
 	}
 
-	const std::vector<cv::Mat>& getBgHsvChannels() const
+	int getFrameNumber() const
 	{
-		return _bg_hsv_channels;
+		return _frame_number;
+	}
+
+	FrameCache* getFrameCache() const
+	{
+		return _cache;
+	}
+
+	void setFrameCache(FrameCache* cache)
+	{
+		_cache = cache;
+	}
+
+	int getPrefetch() const
+	{
+		return _prefetch;
+	}
+
+	/**
+	 * Amount of frames decoded ahead, takes effect when the decode thread starts
+	 */
+	void setPrefetch(int prefetch)
+	{
+		_prefetch = prefetch;
+	}
+
+	const cv::Mat& getBgHsv() const
+	{
+		return _bg_hsv;
+	}
+
+	ForegroundKernel::BackgroundModel& getBgModel()
+	{
+		return _bg_model;
 	}
 
 	bool isInitialized() const
@@ -126,6 +248,11 @@ public:
 		_foreground_image = foregroundImage;
 	}
 
+	void swapForegroundImage(cv::Mat& foregroundImage)
+	{
+		std::swap(_foreground_image, foregroundImage);
+	}
+
 	const cv::Mat& getFrame() const
 	{
 		return _frame;
@@ -0,0 +1,100 @@
+/*
+ * ForegroundKernel.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: Ulisse Bordignon, Nicola Chinellato
+ */
+
+#ifndef FOREGROUNDKERNEL_H_
+#define FOREGROUNDKERNEL_H_
+
+#include <opencv2/opencv.hpp>
+#include <stddef.h>
+
+#include "ThreadPool.h"
+
+namespace nl_uu_science_gmt
+{
+
+/**
+ * HSV background subtraction in a single pass: a BGR pixel is converted to HSV with
+ * OpenCV's fixed-point arithmetic and compared with the background on the spot, so
+ *
+ * 	foreground = (dH > h && |S - bS| > s) || |V - bV| > v
+ *
+ * without any temporary images. Hue is circular, dH is the distance around the
+ * hue circle (at most 90). The background is stored interleaved (H, S, V, 0).
+ *
+ * The thresholds live in three small tables indexed by the channel difference,
+ * changing a threshold only rebuilds its table. On CPUs with AVX2 the rows are done
+ * 8 pixels at a time (only the reciprocals of the conversion are gathered, the tables
+ * become comparisons), bit-identical to the scalar pass.
+ *
+ * The adaptive variant keeps a running mean and variance per pixel and channel
+ * (16 bit fixed point) that follow the background while subtracting: a channel
+ * differs if it exceeds its threshold and lies more than a few standard deviations
+ * from the mean. Its AVX2 rows widen the statistics to 32 bit lanes, a difference
+ * with the mean takes 17 bits, and are bit-identical to the scalar pass as well.
+ */
+class ForegroundKernel
+{
+public:
+	/**
+	 * Running background statistics: mean (H, S, V, 0) with 8 fractional bits and variance (H, S, V, 0)
+	 */
+	struct BackgroundModel
+	{
+		cv::Mat mean;      // CV_16UC4
+		cv::Mat variance;  // CV_16UC4
+	};
+
+private:
+	static const int HSV_SHIFT = 12;
+	static const int HUE_RANGE = 180;
+	static const int MIN_VARIANCE = 4;  // keeps a perfectly still pixel from flagging sensor noise
+
+	static int _sdiv_table[256];
+	static int _hdiv_table[256];
+	static bool _avx2;
+
+	int _h_threshold, _s_threshold, _v_threshold;
+	uchar _h_pass[256], _s_pass[256], _v_pass[256];  // 255 if a channel difference exceeds its threshold
+
+	int _learning_shift;   // the model learns at a rate of 2^-_learning_shift per frame
+	int _deviations_q4;    // squared amount of standard deviations a foreground pixel lies away, 4 fractional bits
+
+	ThreadPool* _pool;     // rows are split over the pool, if any
+
+	static void initTables();
+	static bool fillTables();
+	static void buildPass(int, uchar*);
+
+public:
+	ForegroundKernel();
+
+	void setThresholds(int, int, int);
+	void setAdaptation(int, float);
+
+	static void initModel(const cv::Mat &, BackgroundModel &);
+
+	static void toBackground(const cv::Mat &, cv::Mat &);
+	static void difference(const cv::Mat &, const cv::Mat &, cv::Mat &, ThreadPool* = NULL);
+
+	void subtract(const cv::Mat &, const cv::Mat &, cv::Mat &) const;
+	void threshold(const cv::Mat &, cv::Mat &) const;
+	void subtractAdaptive(const cv::Mat &, BackgroundModel &, cv::Mat &, bool = true) const;
+
+	ThreadPool* getPool() const
+	{
+		return _pool;
+	}
+
+	void setPool(ThreadPool* pool)
+	{
+		_pool = pool;
+	}
+};
+
+} /* namespace nl_uu_science_gmt */
+
+#endif /* FOREGROUNDKERNEL_H_ */
@@ -0,0 +1,67 @@
+/*
+ * FrameCache.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: Ulisse Bordignon, Nicola Chinellato
+ */
+
+#ifndef FRAMECACHE_H_
+#define FRAMECACHE_H_
+
+#include <opencv2/opencv.hpp>
+#include <stddef.h>
+#include <stdint.h>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+namespace nl_uu_science_gmt
+{
+
+/**
+ * Least recently used cache of decoded frames, keyed by (camera, frame number)
+ * and bounded by the memory its frames take, shared by all cameras
+ */
+class FrameCache
+{
+	typedef std::pair<uint64_t, cv::Mat> Entry;
+
+	size_t _budget;  // bytes
+	size_t _size;    // bytes in use
+
+	std::list<Entry> _entries;  // most recently used first
+	std::unordered_map<uint64_t, std::list<Entry>::iterator> _lookup;
+	mutable std::mutex _mutex;
+
+	static uint64_t getKey(int camera, int frame)
+	{
+		return ((uint64_t) (uint32_t) camera << 32) | (uint32_t) frame;
+	}
+
+	// The cache is shared, not copied
+	FrameCache(const FrameCache &);
+	FrameCache& operator=(const FrameCache &);
+
+public:
+	FrameCache(size_t);
+
+	bool get(int, int, cv::Mat &);
+	void put(int, int, const cv::Mat &);
+	void clear();
+
+	size_t getBudget() const
+	{
+		return _budget;
+	}
+
+	size_t getSize() const
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		return _size;
+	}
+};
+
+} /* namespace nl_uu_science_gmt */
+
+#endif /* FRAMECACHE_H_ */
@@ -0,0 +1,96 @@
+/*
+ * FramePipeline.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: Ulisse Bordignon, Nicola Chinellato
+ */
+
+#ifndef FRAMEPIPELINE_H_
+#define FRAMEPIPELINE_H_
+
+#include <opencv2/opencv.hpp>
+#include <stddef.h>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "BoundedQueue.h"
+#include "Reconstructor.h"
+#include "Scene3DRenderer.h"
+
+namespace nl_uu_science_gmt
+{
+
+/**
+ * Everything one frame goes through the pipeline with, the buffers are reused from frame to frame
+ */
+struct FrameJob
+{
+	int frame;                                  // frame number
+	FrameSettings settings;                     // what the stages process the frame with
+	std::vector<cv::Mat> frames;                // video frame per camera
+	std::vector<cv::Mat> foregrounds;           // foreground per camera
+	std::vector<Reconstructor::Voxel> voxels;   // visible voxels
+};
+
+/**
+ * Sequential playback as a pipeline: decode -> foreground -> carve, each stage on its own thread
+ * with bounded queues in between, while the caller commits (and tracks) the finished frames. Frame
+ * N+2 decodes while N+1 is segmented and N is carved, the throughput is that of the slowest stage.
+ *
+ * While the pipeline runs it owns the camera videos and the carving state of the reconstructor;
+ * stop it before seeking or reading video frames otherwise. The stages never read the settings of
+ * the renderer or the reconstructor, every frame carries its own copy (see setSettings()).
+ */
+class FramePipeline
+{
+	Scene3DRenderer &_scene3d;
+
+	std::vector<FrameJob> _jobs;
+	BoundedQueue<FrameJob*> _free;       // jobs to decode into
+	BoundedQueue<FrameJob*> _decoded;
+	BoundedQueue<FrameJob*> _segmented;
+	BoundedQueue<FrameJob*> _carved;     // finished jobs, to commit
+
+	std::thread _decode_thread, _segment_thread, _carve_thread;
+	int _next_frame;
+	int _committed_frame;                // frame the cameras and the reconstructor hold
+	bool _running;
+
+	FrameSettings _settings;             // for the next frames to decode
+	std::mutex _settings_mutex;
+
+	void decode();
+	void segment();
+	void carve();
+
+	// The pipeline owns threads, it isn't copyable
+	FramePipeline(const FramePipeline &);
+	FramePipeline& operator=(const FramePipeline &);
+
+public:
+	FramePipeline(Scene3DRenderer &, size_t = 2);
+	virtual ~FramePipeline();
+
+	void start(int);
+	void stop();
+	void setSettings(const FrameSettings &);
+
+	FrameJob* next();
+	void commit(FrameJob*);
+	void release(FrameJob*);
+
+	bool isRunning() const
+	{
+		return _running;
+	}
+
+	int getCommittedFrame() const
+	{
+		return _committed_frame;
+	}
+};
+
+} /* namespace nl_uu_science_gmt */
+
+#endif /* FRAMEPIPELINE_H_ */
@@ -0,0 +1,115 @@
+/*
+ * FrameProcessor.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: Ulisse Bordignon, Nicola Chinellato
+ */
+
+#ifndef FRAMEPROCESSOR_H_
+#define FRAMEPROCESSOR_H_
+
+#include <opencv2/opencv.hpp>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "FramePipeline.h"
+#include "Scene3DRenderer.h"
+#include "Tracker.h"
+
+namespace nl_uu_science_gmt
+{
+
+/**
+ * What the renderer shows of a processed frame, a copy so processing can go on while it's drawn
+ */
+struct FrameSnapshot
+{
+	int frame;                                     // frame number, -1 before the first one
+	int camera;                                    // camera of the video and foreground images
+	cv::Mat video;
+	cv::Mat foreground;
+	std::vector<cv::Point3f> voxels;               // visible voxels
+	std::vector<cv::Vec4f> voxel_colors;
+	std::vector<std::vector<cv::Point2f>> centers; // cluster center tracks
+	std::vector<cv::Scalar> center_colors;
+};
+
+/**
+ * Plays the video on its own thread, as fast as the frame pipeline goes, independent of the rendering.
+ * Every processed (and tracked) frame is published as a double buffered snapshot: the processing thread
+ * fills the back buffer, the renderer reads the front one while holding the snapshot lock.
+ *
+ * While running, the processor owns the cameras, the reconstructor and the tracker.
+ */
+class FrameProcessor
+{
+	Scene3DRenderer &_scene3d;
+	Tracker &_tracker;
+	FramePipeline _pipeline;
+
+	FrameSnapshot _snapshots[2];
+	int _front;                  // index of the snapshot the renderer reads
+	std::atomic<int> _camera;    // camera the snapshots show, selected on the UI thread
+	std::mutex _snapshot_mutex;
+
+	std::thread _thread;
+	std::atomic<bool> _stop;
+	bool _running;
+	bool _interactive;           // tracker setting to restore after running
+
+	void run();
+
+	// The processor owns a thread, it isn't copyable
+	FrameProcessor(const FrameProcessor &);
+	FrameProcessor& operator=(const FrameProcessor &);
+
+public:
+	FrameProcessor(Scene3DRenderer &, Tracker &);
+	virtual ~FrameProcessor();
+
+	void start(int);
+	void stop();
+
+	void publish(int);
+	int getFrame();
+
+	bool isRunning() const
+	{
+		return _running;
+	}
+
+	/**
+	 * The camera whose video and foreground the next snapshots show, call it from the thread that selects it
+	 */
+	void setCamera(int camera)
+	{
+		_camera = camera;
+	}
+
+	/**
+	 * The settings the next frames are processed with, call it from the thread that changes them
+	 */
+	void setSettings(const FrameSettings &settings)
+	{
+		_pipeline.setSettings(settings);
+	}
+
+	/**
+	 * The snapshot to show, only while holding getSnapshotMutex()
+	 */
+	const FrameSnapshot& getSnapshot() const
+	{
+		return _snapshots[_front];
+	}
+
+	std::mutex& getSnapshotMutex()
+	{
+		return _snapshot_mutex;
+	}
+};
+
+} /* namespace nl_uu_science_gmt */
+
+#endif /* FRAMEPROCESSOR_H_ */
@@ -9,10 +9,8 @@
 #define GENERAL_H_
 
 #include <fstream>
-
-#ifdef _OPENMP
-#include <omp.h>
-#endif
+#include <stddef.h>
+#include <stdint.h>
 
 #include <opencv2/opencv.hpp>
 
@@ -32,11 +30,6 @@ namespace nl_uu_science_gmt
 const static std::string VERSION = "2.0";
 const static std::string VIDEO_WINDOW = "Video";
 const static std::string SCENE_WINDOW = "OpenGL 3D scene";
-#ifdef DEBUG
-const static int NUM_THREADS = 1;
-#else
-const static int NUM_THREADS = cv::getNumberOfCPUs();
-#endif
 
 // Some OpenCV colors
 const static cv::Scalar Color_BLUE = cv::Scalar(255, 0, 0);
@@ -57,12 +50,16 @@ public:
 	static const std::string CheckerboadVideo;
 	static const std::string CheckerboadCorners;
 	static const std::string VideoFile;
+	static const std::string VideoIndexFile;
+	static const std::string ReconstructionFile;
+	static const std::string TrackFile;
 	static const std::string BackgroundImageFile;
 	static const std::string BackgroundVideoFile;
 	static const std::string ConfigFile;
 
 	static bool fexists(const std::string &);
 	static float pointDistance(const cv::Point&, const cv::Point&);
+	static uint64_t hash(const void*, size_t, uint64_t = 14695981039346656037ULL);
 	static bool popup(const std::string &, const std::string &);
 	static void popupCallback(int, int, int, int, void *);
 };
@@ -19,6 +19,7 @@
 #include "arcball.h"
 
 #include "General.h"
+#include "FrameProcessor.h"
 #include "Scene3DRenderer.h"
 #include "Reconstructor.h"
 #include "Tracker.h"
@@ -36,6 +37,7 @@ namespace nl_uu_science_gmt
 	{
 		Scene3DRenderer &_scene3d;
 		Tracker &_tracker;
+		FrameProcessor _processor;
 
 		static Glut* _glut;
 
@@ -48,6 +50,8 @@ namespace nl_uu_science_gmt
 		static void drawInfo();
 		static void drawClustersCenters();
 
+		static void stopProcessor();
+
 		static void optimizeHSV(bool);
 		static bool drawOptimization(cv::Mat, const cv::Scalar&, const cv::Scalar&);
 
@@ -85,6 +89,11 @@ namespace nl_uu_science_gmt
 			return _scene3d;
 		}
 
+		FrameProcessor& getProcessor()
+		{
+			return _processor;
+		}
+
 		Tracker& getTracker() const
 		{
 			return _tracker;
@@ -0,0 +1,61 @@
+/*
+ * MappedFile.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: Ulisse Bordignon, Nicola Chinellato
+ */
+
+#ifndef MAPPEDFILE_H_
+#define MAPPEDFILE_H_
+
+#include <stddef.h>
+#include <string>
+
+namespace nl_uu_science_gmt
+{
+
+/**
+ * Read-only memory mapping of a file (mmap on Linux, MapViewOfFile on Windows)
+ */
+class MappedFile
+{
+	const char* _data;
+	size_t _size;
+
+#ifdef _WIN32
+	void* _file;     // HANDLE of the opened file
+	void* _mapping;  // HANDLE of the file mapping object
+#else
+	int _fd;
+#endif
+
+	// Mappings are not copyable
+	MappedFile(const MappedFile &);
+	MappedFile& operator=(const MappedFile &);
+
+public:
+	MappedFile();
+	virtual ~MappedFile();
+
+	bool open(const std::string &);
+	void close();
+
+	bool isOpen() const
+	{
+		return _data != NULL;
+	}
+
+	const char* getData() const
+	{
+		return _data;
+	}
+
+	size_t getSize() const
+	{
+		return _size;
+	}
+};
+
+} /* namespace nl_uu_science_gmt */
+
+#endif /* MAPPEDFILE_H_ */
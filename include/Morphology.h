@@ -0,0 +1,67 @@
+/*
+ * Morphology.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: Ulisse Bordignon, Nicola Chinellato
+ */
+
+#ifndef MORPHOLOGY_H_
+#define MORPHOLOGY_H_
+
+#include <opencv2/opencv.hpp>
+#include <stddef.h>
+
+#include "ThreadPool.h"
+
+namespace nl_uu_science_gmt
+{
+
+/**
+ * Binary/grayscale erosion, dilation, opening and closing of 8 bit images with a square
+ * of side 2 * radius + 1, separable and with the van Herk/Gil-Werman algorithm per row
+ * and column, so the cost per pixel doesn't depend on the radius. Rounds of erosion and
+ * dilation with OpenCV's 4x4 ellipse match cv::erode and cv::dilate exactly.
+ *
+ * Pixels outside the image don't take part (as OpenCV's default border).
+ * The buffers are kept between calls, rows and column blocks are split over the pool, if any.
+ */
+class Morphology
+{
+	cv::Mat _g, _h;  // block-wise prefix and suffix extrema of the column pass
+	cv::Mat _tmp;
+	cv::Mat _src;    // source rows the ellipse still reads while filtering in place
+
+	ThreadPool* _pool;
+
+	template<bool MAX> void filterRows(const cv::Mat &, cv::Mat &, int);
+	template<bool MAX> void filterColumns(const cv::Mat &, cv::Mat &, int);
+	template<bool MAX> void filterEllipse(const cv::Mat &, cv::Mat &);
+
+public:
+	Morphology() :
+			_pool(NULL)
+	{
+	}
+
+	void erode(const cv::Mat &, cv::Mat &, int);
+	void dilate(const cv::Mat &, cv::Mat &, int);
+
+	void open(cv::Mat &, int);
+	void close(cv::Mat &, int);
+	void erodeDilate(cv::Mat &, int);
+	void dilateErode(cv::Mat &, int);
+
+	ThreadPool* getPool() const
+	{
+		return _pool;
+	}
+
+	void setPool(ThreadPool* pool)
+	{
+		_pool = pool;
+	}
+};
+
+} /* namespace nl_uu_science_gmt */
+
+#endif /* MORPHOLOGY_H_ */
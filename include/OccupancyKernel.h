@@ -0,0 +1,49 @@
+/*
+ * OccupancyKernel.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: Ulisse Bordignon, Nicola Chinellato
+ */
+
+#ifndef OCCUPANCYKERNEL_H_
+#define OCCUPANCYKERNEL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace nl_uu_science_gmt
+{
+
+/**
+ * Voxel occupancy test: a voxel is occupied if its projection is valid and
+ * falls on a white (255) foreground pixel on every camera.
+ *
+ * All kernels write the indices of the occupied voxels in [begin, end) to the
+ * output in increasing order and return how many there are, so they give
+ * bit-identical results. The vectorized kernels gather 4 bytes per lookup,
+ * every foreground buffer needs PADDING readable bytes after its last pixel.
+ */
+class OccupancyKernel
+{
+public:
+	enum Type
+	{
+		SCALAR, AVX2, AVX512
+	};
+
+	static const size_t PADDING = 3;
+
+	typedef size_t (*Function)(const uint32_t* const *, const unsigned char* const *, int, int, int, int*);
+
+	static Type detect();
+	static Function get(Type);
+	static const char* getName(Type);
+
+	static size_t scalar(const uint32_t* const *, const unsigned char* const *, int, int, int, int*);
+	static size_t avx2(const uint32_t* const *, const unsigned char* const *, int, int, int, int*);
+	static size_t avx512(const uint32_t* const *, const unsigned char* const *, int, int, int, int*);
+};
+
+} /* namespace nl_uu_science_gmt */
+
+#endif /* OCCUPANCYKERNEL_H_ */
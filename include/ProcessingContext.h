@@ -0,0 +1,100 @@
+/*
+ * ProcessingContext.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: Ulisse Bordignon, Nicola Chinellato
+ */
+
+#ifndef PROCESSINGCONTEXT_H_
+#define PROCESSINGCONTEXT_H_
+
+#include <opencv2/opencv.hpp>
+#include <stdint.h>
+#include <fstream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "Camera.h"
+#include "FrameCache.h"
+#include "FramePipeline.h"
+#include "ProcessingOptions.h"
+#include "Reconstructor.h"
+#include "Scene3DRenderer.h"
+#include "ThreadPool.h"
+#include "Tracker.h"
+
+namespace nl_uu_science_gmt
+{
+
+/**
+ * Everything needed to reconstruct (and track) one recording of one camera rig without any window:
+ * its cameras, voxel space, reconstructor, tracker and output files. Contexts share nothing but the thread
+ * pool, so several rigs can be processed side by side. The frames of one rig go through a frame pipeline
+ * of its own, decoding, segmenting and carving overlap; they're tracked and written in order.
+ *
+ * Outputs, in the output path (default the data path):
+ * - General::ReconstructionFile: per frame the frame number, the amount of voxels and their x, y, z (all int32)
+ * - General::TrackFile (with --track): per frame the frame number and the cluster centers, one line per frame
+ */
+class ProcessingContext
+{
+	const std::string _data_path;
+	const int _cameras_amount;
+	std::string _output_path;          // including a file name prefix, if any
+
+	std::vector<Camera*> _cameras;
+	FrameCache* _frame_cache;
+	Reconstructor* _reconstructor;
+	Scene3DRenderer* _scene3d;
+	Tracker* _tracker;
+	FramePipeline* _pipeline;
+
+	std::ofstream _voxels_file;
+	std::ofstream _track_file;
+
+	int _frame;                        // next frame to process
+	int _frames;                       // amount of frames to process
+	int64_t _start;                    // tick count of the first frame
+	bool _good;
+
+	bool processFrame();
+
+	static void writeVoxels(std::ostream &, int, const std::vector<Reconstructor::Voxel> &);
+
+	// A context owns its cameras, it isn't copyable
+	ProcessingContext(const ProcessingContext &);
+	ProcessingContext& operator=(const ProcessingContext &);
+
+public:
+	ProcessingContext(const std::string &, int);
+	virtual ~ProcessingContext();
+
+	bool initialize(int, char**, const ProcessingOptions &, ThreadPool* = NULL);
+	bool run();
+	bool finish();
+
+	const std::string& getDataPath() const
+	{
+		return _data_path;
+	}
+
+	const std::string& getOutputPath() const
+	{
+		return _output_path;
+	}
+
+	void setOutputPath(const std::string &output_path)
+	{
+		_output_path = output_path;
+	}
+
+	bool isGood() const
+	{
+		return _good;
+	}
+};
+
+} /* namespace nl_uu_science_gmt */
+
+#endif /* PROCESSINGCONTEXT_H_ */
@@ -0,0 +1,36 @@
+/*
+ * ProcessingOptions.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: Ulisse Bordignon, Nicola Chinellato
+ */
+
+#ifndef PROCESSINGOPTIONS_H_
+#define PROCESSINGOPTIONS_H_
+
+#include <stddef.h>
+
+#include "Scene3DRenderer.h"
+
+namespace nl_uu_science_gmt
+{
+
+/**
+ * The processing options of the command line, parsed once for the interactive and the headless mode alike
+ * (the voxel space is a VolumeConfig, it's read per rig)
+ */
+struct ProcessingOptions
+{
+	int prefetch;            // frames each camera decodes ahead
+	size_t cache_size;       // bytes for decoded frames revisited while scrubbing
+	FrameSettings settings;  // thresholds, morphology and background to start with (headless)
+	bool track;              // track with the color model (headless)
+
+	ProcessingOptions();
+
+	bool parse(int, char**);
+};
+
+} /* namespace nl_uu_science_gmt */
+
+#endif /* PROCESSINGOPTIONS_H_ */
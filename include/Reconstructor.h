@@ -12,70 +12,208 @@
 #include <stddef.h>
 #include <vector>
 
-#ifdef _OPENMP
-#include <omp.h>
-#endif
-
-#include <opencv2/opencv.hpp>
-
 #include "Camera.h"
+#include "OccupancyKernel.h"
+#include "ThreadPool.h"
+#include "VoxelLUT.h"
 
 namespace nl_uu_science_gmt
 {
 
+/**
+ * Voxel space configuration, all values in mm (upper bounds are exclusive)
+ */
+struct VolumeConfig
+{
+	int x_min, x_max;
+	int y_min, y_max;
+	int z_min, z_max;
+	int step;  // voxel edge
+
+	bool roi;  // only reconstruct the region of interest below
+	int roi_x_min, roi_x_max;
+	int roi_y_min, roi_y_max;
+	int roi_z_min, roi_z_max;
+
+	VolumeConfig();
+
+	void read(const std::string &);
+	bool parse(int, char**);
+	bool validate() const;
+};
+
 class Reconstructor
 {
 public:
-	struct Voxel
+	/**
+	 * Structure-of-arrays storage of the whole voxel space
+	 */
+	struct VoxelStore
+	{
+		std::vector<int> x, y, z;
+		std::vector<const uint32_t*> camera_projection;  // per camera, one linear pixel offset per voxel
+		std::vector<const uint64_t*> valid_camera_projection;  // per camera, one bit per voxel
+		std::vector<cv::Vec4f> color;
+
+		size_t size() const
+		{
+			return x.size();
+		}
+	};
+
+	/**
+	 * Lightweight view on a single voxel in the VoxelStore
+	 */
+	class Voxel
 	{
-		int x, y, z;
-		cv::Scalar color;
-		std::vector<cv::Point> camera_projection;
-		std::vector<int> valid_camera_projection;
+		VoxelStore* _store;
+		int _index;
+
+	public:
+		Voxel() :
+				_store(NULL), _index(-1)
+		{
+		}
+
+		Voxel(VoxelStore* store, int index) :
+				_store(store), _index(index)
+		{
+		}
+
+		int getIndex() const
+		{
+			return _index;
+		}
+
+		int getX() const
+		{
+			return _store->x[_index];
+		}
+
+		int getY() const
+		{
+			return _store->y[_index];
+		}
+
+		int getZ() const
+		{
+			return _store->z[_index];
+		}
+
+		const cv::Vec4f& getColor() const
+		{
+			return _store->color[_index];
+		}
+
+		void setColor(const cv::Scalar& color) const
+		{
+			_store->color[_index] = cv::Vec4f((float)color[0], (float)color[1], (float)color[2], (float)color[3]);
+		}
+
+		static bool compareIndex(const Voxel& a, const Voxel& b)
+		{
+			return a._index < b._index;
+		}
 	};
 
 private:
+	enum BlockClass
+	{
+		BLOCK_OUT, BLOCK_IN, BLOCK_MIXED
+	};
+
+	/**
+	 * Pixel rectangle around the projections of the voxels of an octree block on one camera
+	 */
+	struct BlockBounds
+	{
+		short left, top, right, bottom;  // right and bottom exclusive, empty if no voxel projects on the camera
+		bool complete;                   // every voxel of the block projects on the camera
+	};
+
 	const std::vector<Camera*> &_cameras;
 
+	const VolumeConfig _config;
+	ThreadPool* _pool;  // for the parallel loops, none runs them on the calling thread
+
 	int _step;
 	int _size;
 
 	std::vector<cv::Point3f*> _corners;
 
 	size_t _voxels_amount;
+	cv::Point3i _grid_origin;       // position of the first voxel
+	int _grid_x, _grid_y, _grid_z;  // amount of voxels along each axis
 	cv::Size _plane_size;
 
-	std::vector<Voxel*> _voxels;
-	std::vector<Voxel*> _visible_voxels;
+	VoxelStore _voxels;
+	std::vector<Voxel> _visible_voxels;  // result of the last update, for the readers
+	std::vector<Voxel> _carved_voxels;   // carving output, swapped into the result
+	std::vector<cv::Mat> _foregrounds;
 
 	std::string _data_path;
 
+	VoxelLUT _lut;
+
+	OccupancyKernel::Function _occupancy_kernel;
+	std::vector<cv::Mat> _padded_foregrounds;  // foreground copies with room for the vectorized gathers
+	std::vector<std::vector<int> > _chunk_visible;  // occupied voxel indices per chunk of a parallel loop
+
+	bool _incremental;        // only re-evaluate voxels that project on changed foreground pixels
+	bool _incremental_valid;  // _camera_hits and _occupied match _previous_foregrounds
+	std::vector<cv::Mat> _previous_foregrounds;
+	std::vector<uchar> _camera_hits;  // per voxel: amount of cameras with a white pixel at its projection
+	std::vector<uint64_t> _occupied;  // per voxel: hit on all cameras
+
+	bool _octree;                     // coarse-to-fine carving of blocks of voxels
+	std::vector<cv::Mat> _integrals;  // integral images of the foregrounds
+	std::vector<std::vector<BlockBounds> > _block_bounds;  // per level (block edge 2, 4, 8, ...), per block and camera
+
 	void initialize();
+	void buildLUT(const VoxelLUT::Header &);
+
+	int getChunks(int) const;
+	void gatherChunks();
+	void carve(const std::vector<const uchar*> &);
+	bool carveFromPixels(const std::vector<const uchar*> &);
+	void seedOccupancy(const std::vector<const uchar*> &);
+	bool updateOccupancy(const std::vector<const uchar*> &);
+	void collectOccupied();
+	void buildBlockBounds(int);
+	void carveOctree(const std::vector<const uchar*> &);
+	void carveBlock(int, int, int, int, const std::vector<const uchar*> &, std::vector<int> &) const;
+	BlockClass classifyBlock(int, int, int, int) const;
 
 public:
-	Reconstructor(const std::vector<Camera*> &, const std::string&);
+	Reconstructor(const std::vector<Camera*> &, const std::string&, const VolumeConfig& = VolumeConfig(), ThreadPool* = NULL);
 	virtual ~Reconstructor();
 
 	void update();
+	void reconstruct(const std::vector<cv::Mat> &, std::vector<Voxel> &, bool, bool);
 
-	const std::vector<Voxel*>& getVisibleVoxels() const
+	const std::vector<Voxel>& getVisibleVoxels() const
 	{
 		return _visible_voxels;
 	}
 
-	const std::vector<Voxel*>& getVoxels() const
+	void setVisibleVoxels(const std::vector<Voxel>& visibleVoxels)
 	{
-		return _voxels;
+		_visible_voxels = visibleVoxels;
 	}
 
-	void setVisibleVoxels(const std::vector<Voxel*>& visibleVoxels)
+	void swapVisibleVoxels(std::vector<Voxel>& visibleVoxels)
 	{
-		_visible_voxels = visibleVoxels;
+		_visible_voxels.swap(visibleVoxels);
+	}
+
+	const VoxelStore& getVoxels() const
+	{
+		return _voxels;
 	}
 
-	void setVoxels(const std::vector<Voxel*>& voxels)
+	size_t getVoxelsAmount() const
 	{
-		_voxels = voxels;
+		return _voxels_amount;
 	}
 
 	const std::vector<cv::Point3f*>& getCorners() const
@@ -88,10 +226,45 @@ public:
 		return _size;
 	}
 
+	int getStep() const
+	{
+		return _step;
+	}
+
+	const VolumeConfig& getConfig() const
+	{
+		return _config;
+	}
+
+	ThreadPool* getPool() const
+	{
+		return _pool;
+	}
+
 	const cv::Size& getPlaneSize() const
 	{
 		return _plane_size;
 	}
+
+	bool isIncremental() const
+	{
+		return _incremental;
+	}
+
+	void setIncremental(bool incremental)
+	{
+		_incremental = incremental;
+	}
+
+	bool isOctree() const
+	{
+		return _octree;
+	}
+
+	void setOctree(bool octree)
+	{
+		_octree = octree;
+	}
 };
 
 } /* namespace nl_uu_science_gmt */
@@ -19,10 +19,26 @@
 #include "General.h"
 #include "Reconstructor.h"
 #include "Camera.h"
+#include "ForegroundKernel.h"
+#include "Morphology.h"
 
 namespace nl_uu_science_gmt
 {
 
+/**
+ * The settings a frame is segmented and carved with. The sliders and keys change them on the UI thread,
+ * a frame in the pipeline is processed with the copy taken when it was decoded.
+ */
+struct FrameSettings
+{
+	int h_threshold, s_threshold, v_threshold;
+	int e_d_selection;            // 0: opening, 1: closing
+	int e_d_number;               // erode/dilate rounds, 0 for none
+	bool adaptive;                // running background model
+	bool incremental;             // carving mode of the reconstructor
+	bool octree;
+};
+
 class Scene3DRenderer
 {
 	Reconstructor &_reconstructor;
@@ -69,6 +85,13 @@ class Scene3DRenderer
 	int _e_d_selection;
 	int _e_d_number;
 
+	ForegroundKernel _foreground_kernel;
+	bool _adaptive;                          // subtract a running background model instead of the still one
+	Morphology _morphology;
+	std::vector<int> _foreground_frames;     // frame number of each camera's last foreground
+	std::vector<cv::Mat> _differences;       // HSV differences, for re-thresholding an unchanged frame
+	std::vector<int> _difference_frames;     // frame number of each camera's differences
+
 	// edge points of the virtual ground floor grid
 	std::vector<std::vector<cv::Point3i*> > _floor_grid;
 
@@ -79,10 +102,13 @@ class Scene3DRenderer
 #endif
 
 public:
-	Scene3DRenderer(Reconstructor &, const std::vector<Camera*> &);
+	Scene3DRenderer(Reconstructor &, const std::vector<Camera*> &, bool = true);
 	virtual ~Scene3DRenderer();
 
 	void processForeground(Camera*);
+	void processForeground(size_t, const cv::Mat &, int, cv::Mat &, const FrameSettings &);
+	FrameSettings getSettings() const;
+	void setSettings(const FrameSettings &);
 
 	bool processFrame();
 	void setCamera(int);
@@ -193,6 +219,16 @@ public:
 		_current_frame = currentFrame;
 	}
 
+	bool isAdaptive() const
+	{
+		return _adaptive;
+	}
+
+	void setAdaptive(bool adaptive)
+	{
+		_adaptive = adaptive;
+	}
+
 	bool isPaused() const
 	{
 		return _paused;
@@ -377,6 +413,16 @@ public:
 		_s_threshold = threshold;
 	}
 
+	void setEDSelection(int selection)
+	{
+		_e_d_selection = selection;
+	}
+
+	void setEDNumber(int number)
+	{
+		_e_d_number = number;
+	}
+
 	void setVThreshold(int threshold)
 	{
 		_v_threshold = threshold;
@@ -0,0 +1,101 @@
+/*
+ * ThreadPool.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: Ulisse Bordignon, Nicola Chinellato
+ */
+
+#ifndef THREADPOOL_H_
+#define THREADPOOL_H_
+
+#include <stddef.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace nl_uu_science_gmt
+{
+
+/**
+ * The one task scheduler of the process: a fixed set of worker threads, optionally pinned to CPUs,
+ * shared by everything that processes frames (segmentation, carving, LUT building, whole frames of
+ * the rigs in batch mode).
+ *
+ * Work stealing: every worker has its own deque, tasks submitted by a worker go to its own deque and
+ * are taken back newest first (cache warm), idle workers steal the oldest tasks of the others. Tasks
+ * from other threads are spread round robin.
+ *
+ * parallelFor() is the replacement of the OpenMP loops: the calling thread works along and only waits
+ * for chunks other threads already started, so it may be called from within tasks without deadlocking.
+ */
+class ThreadPool
+{
+	struct Queue
+	{
+		std::deque<std::function<void()>> tasks;
+		std::mutex mutex;
+	};
+
+	std::vector<Queue*> _queues;  // one per worker
+	std::vector<std::thread> _workers;
+	std::vector<int> _cpus;       // CPU of worker t: _cpus[t % _cpus.size()], none if empty
+
+	std::atomic<size_t> _pending; // queued tasks
+	std::atomic<size_t> _busy;    // tasks being run
+	std::atomic<size_t> _next;    // round robin queue for submissions from outside the pool
+	bool _stop;
+
+	std::mutex _mutex;
+	std::condition_variable _task_available;
+	std::condition_variable _idle;
+
+	bool popTask(size_t, std::function<void()> &);
+	void work(size_t);
+	int getWorker() const;
+
+	// The pool owns threads, it isn't copyable
+	ThreadPool(const ThreadPool &);
+	ThreadPool& operator=(const ThreadPool &);
+
+public:
+	ThreadPool(size_t = 0, const std::vector<int> & = std::vector<int>());
+	virtual ~ThreadPool();
+
+	void submit(const std::function<void()> &);
+	void wait();
+	void parallelFor(int, int, const std::function<void(int, int)> &, int = 1);
+
+	static bool parseCpus(const std::string &, std::vector<int> &);
+	static bool pin(std::thread &, int);
+	static void setOpenCVThreads(int);
+
+	size_t size() const
+	{
+		return _workers.size();
+	}
+
+	const std::vector<int>& getCpus() const
+	{
+		return _cpus;
+	}
+};
+
+/**
+ * body(begin, end) over [begin, end) in chunks of at least 'grain' on 'pool', or at once on this thread without a pool
+ */
+inline void parallelFor(ThreadPool* pool, int begin, int end, const std::function<void(int, int)> &body, int grain = 1)
+{
+	if (pool != NULL)
+		pool->parallelFor(begin, end, body, grain);
+	else if (begin < end)
+		body(begin, end);
+}
+
+} /* namespace nl_uu_science_gmt */
+
+#endif /* THREADPOOL_H_ */
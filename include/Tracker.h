@@ -13,6 +13,7 @@
 #ifdef _WIN32
 #include <Windows.h>
 #endif
+#include <ostream>
 #include <vector>
 
 #include "General.h"
@@ -30,7 +31,7 @@ namespace nl_uu_science_gmt
 	public:
 		struct VoxelAttributes
 		{
-			Reconstructor::Voxel* voxel;
+			Reconstructor::Voxel voxel;
 			cv::Point2i projection;
 			int label;
 		};
@@ -50,15 +51,18 @@ namespace nl_uu_science_gmt
 		Scene3DRenderer &_scene3d;
 		std::vector<ColorModel*> _color_models;
 		bool _active;
+		bool _interactive;                      // may open windows to ask the user
 		int _clusters_number;
 		std::vector<std::vector<cv::Point2f>> _unrefined_centers;
 		std::vector<std::vector<cv::Point2f>> _refined_centers;
+		std::vector<cv::Point3f> _points;       // projectVoxels buffers, reused between frames
+		std::vector<cv::Point2f> _projections;
 
 		void createColorModel();
 		void saveColorModel();
 		void loadColorModel();
 		float chiSquared(const ColorModel*, const ColorModel*);
-		void projectVoxels(std::vector<Reconstructor::Voxel*>, std::vector<std::map<float, VoxelAttributes*>>&, const cv::Mat = cv::Mat(), const int = 0);
+		void projectVoxels(std::vector<Reconstructor::Voxel>, std::vector<std::map<float, VoxelAttributes*>>&, const cv::Mat = cv::Mat(), const int = 0);
 
 	public:
 		Tracker(const std::vector<Camera*> &, const std::string&, Scene3DRenderer&, int = 3);
@@ -66,6 +70,7 @@ namespace nl_uu_science_gmt
 		void update();
 
 		void saveTrack();
+		void writeTrack(std::ostream&) const;
 
 		const std::vector<Camera*>& getCameras() const
 		{
@@ -80,6 +85,14 @@ namespace nl_uu_science_gmt
 			_active = active;
 		}
 
+		bool isInteractive() const {
+			return _interactive;
+		}
+
+		void setInteractive(bool interactive) {
+			_interactive = interactive;
+		}
+
 		void toggleActive() {
 			_active = !_active;
 		}
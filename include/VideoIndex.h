@@ -0,0 +1,59 @@
+/*
+ * VideoIndex.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: Ulisse Bordignon, Nicola Chinellato
+ */
+
+#ifndef VIDEOINDEX_H_
+#define VIDEOINDEX_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace nl_uu_science_gmt
+{
+
+/**
+ * Frame count and keyframe positions of an AVI video, read from its idx1 chunk
+ * and cached in an XML file next to the video
+ */
+class VideoIndex
+{
+	size_t _video_size;           // size of the indexed video file, to detect a changed video
+	uint64_t _video_hash;         // hash of its first and last KB, to detect a re-encoded video of the same size
+	long _frames;
+	std::vector<int> _keyframes;  // ascending frame numbers
+
+	bool parse(const std::string &);
+	bool load(const std::string &, size_t, uint64_t);
+	void save(const std::string &) const;
+
+public:
+	VideoIndex();
+
+	bool open(const std::string &, const std::string &);
+
+	int getKeyframe(int) const;
+
+	bool isEmpty() const
+	{
+		return _frames == 0;
+	}
+
+	long getFramesAmount() const
+	{
+		return _frames;
+	}
+
+	const std::vector<int>& getKeyframes() const
+	{
+		return _keyframes;
+	}
+};
+
+} /* namespace nl_uu_science_gmt */
+
+#endif /* VIDEOINDEX_H_ */
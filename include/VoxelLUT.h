@@ -0,0 +1,146 @@
+/*
+ * VoxelLUT.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: Ulisse Bordignon, Nicola Chinellato
+ */
+
+#ifndef VOXELLUT_H_
+#define VOXELLUT_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "MappedFile.h"
+
+namespace nl_uu_science_gmt
+{
+
+/**
+ * Binary look up tables between the voxels and the camera pixels
+ *
+ * The file starts with a fixed size header and a table with the size of the
+ * pixel index of every camera. Then, for each camera:
+ * 	- voxel to pixel: the projection of every voxel as a linear pixel offset into
+ * 	  the camera image (y * width + x, INVALID_PROJECTION if it falls outside of
+ * 	  the image) and a validity bitset
+ * And after that, for each camera:
+ * 	- pixel to voxels: a compressed sparse row index, for each pixel the start of
+ * 	  its (sorted) voxel list and the concatenated voxel lists of all pixels
+ * All sections are 64 byte aligned so they can be used straight from the memory
+ * mapped file.
+ */
+class VoxelLUT
+{
+public:
+	static const uint32_t VERSION = 3;
+	static const uint32_t INVALID_PROJECTION = 0xFFFFFFFF;
+
+	struct Header
+	{
+		char magic[8];
+		uint32_t version;
+		uint32_t cameras;
+		int32_t x_min, x_max;
+		int32_t y_min, y_max;
+		int32_t z_min, z_max;
+		int32_t step;
+		int32_t width, height;  // camera image size
+		int32_t reserved;
+		uint64_t voxels;
+		uint64_t calibration_hash;  // hash of the calibration of all cameras
+	};
+
+private:
+	Header _header;
+
+	MappedFile _file;
+	std::vector<uint64_t> _buffer;  // LUT memory when built in memory instead of mapped
+	const char* _data;
+	size_t _size;
+
+	std::vector<size_t> _pixel_index_offsets;  // per camera offset of the pixel to voxels index
+
+	size_t getPixelsAmount() const;
+	size_t getProjectionsOffset(int) const;
+	size_t getValidityOffset(int) const;
+	size_t getPixelIndexOffset() const;
+	void computePixelIndexOffsets();
+
+	// LUTs are not copyable
+	VoxelLUT(const VoxelLUT &);
+	VoxelLUT& operator=(const VoxelLUT &);
+
+public:
+	VoxelLUT();
+	virtual ~VoxelLUT();
+
+	static Header createHeader();
+	static std::string getFilename(const Header &);
+
+	bool load(const std::string &, const Header &);
+	void create(const Header &);
+	void buildPixelIndex();
+	bool save(const std::string &) const;
+	void release();
+
+	uint32_t* getWritableProjections(int);
+	uint64_t* getWritableValidity(int);
+
+	const uint32_t* getProjections(int camera) const
+	{
+		return (const uint32_t*) (_data + getProjectionsOffset(camera));
+	}
+
+	const uint64_t* getValidity(int camera) const
+	{
+		return (const uint64_t*) (_data + getValidityOffset(camera));
+	}
+
+	// pixel p owns the entries [start[p], start[p + 1]) of getPixelVoxels()
+	const uint32_t* getPixelVoxelsStart(int camera) const
+	{
+		return (const uint32_t*) (_data + _pixel_index_offsets[camera]);
+	}
+
+	const uint32_t* getPixelVoxels(int camera) const
+	{
+		return getPixelVoxelsStart(camera) + getPixelsAmount() + 1;
+	}
+
+	uint64_t getPixelVoxelsAmount(int camera) const
+	{
+		return ((const uint64_t*) (_data + getPixelIndexOffset()))[camera];
+	}
+
+	static bool isSet(const uint64_t* bits, size_t i)
+	{
+		return ((bits[i >> 6] >> (i & 63)) & 1) != 0;
+	}
+
+	static void set(uint64_t* bits, size_t i)
+	{
+		bits[i >> 6] |= (uint64_t) 1 << (i & 63);
+	}
+
+	bool isLoaded() const
+	{
+		return _data != NULL;
+	}
+
+	bool isMapped() const
+	{
+		return _file.isOpen();
+	}
+
+	const Header& getHeader() const
+	{
+		return _header;
+	}
+};
+
+} /* namespace nl_uu_science_gmt */
+
+#endif /* VOXELLUT_H_ */
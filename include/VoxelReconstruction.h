@@ -9,11 +9,14 @@
 #define VOXELRECONSTRUCTION_H_
 
 #include <opencv2/opencv.hpp>
+#include <stddef.h>
+#include <vector>
 
 #include "arcball.h"
 
 #include "General.h"
 #include "Camera.h"
+#include "ProcessingOptions.h"
 #include "Reconstructor.h"
 #include "Scene3DRenderer.h"
 #include "Glut.h"
@@ -28,13 +31,15 @@ class VoxelReconstruction
 
 	std::vector<Camera*> _cam_views;
 
+	bool setup(int, char**, const ProcessingOptions&, VolumeConfig&);
+
 public:
 	VoxelReconstruction(const std::string &, const int);
 	virtual ~VoxelReconstruction();
 
 	static void showKeys();
 
-	void run(int, char**);
+	bool run(int, char**, const ProcessingOptions&, ThreadPool* = NULL);
 };
 
 } /* namespace nl_uu_science_gmt */
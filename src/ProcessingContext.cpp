@@ -0,0 +1,192 @@
+/*
+ * ProcessingContext.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: Ulisse Bordignon, Nicola Chinellato
+ */
+
+#include "ProcessingContext.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <cassert>
+#include <iostream>
+#include <sstream>
+
+#include "General.h"
+
+using namespace std;
+using namespace cv;
+
+namespace nl_uu_science_gmt
+{
+
+/**
+ * A rig of 'cameras' views in 'data_path' (cam1, cam2, ...), nothing is read until initialize()
+ */
+ProcessingContext::ProcessingContext(const string &data_path, int cameras) :
+		_data_path(data_path), _cameras_amount(cameras), _output_path(data_path), _frame_cache(NULL),
+		_reconstructor(NULL), _scene3d(NULL), _tracker(NULL), _pipeline(NULL), _frame(0), _frames(0), _start(0), _good(false)
+{
+}
+
+ProcessingContext::~ProcessingContext()
+{
+	delete _pipeline;
+	delete _tracker;
+	delete _scene3d;
+	delete _reconstructor;
+	for (size_t c = 0; c < _cameras.size(); ++c)
+		delete _cameras[c];
+	delete _frame_cache;
+}
+
+/**
+ * Read the cameras, build the voxel space and open the output files, with the voxel space of the command
+ * line (--step, --volume and --roi) and the given options; the per frame loops run on 'pool', if any
+ */
+bool ProcessingContext::initialize(int argc, char** argv, const ProcessingOptions &options, ThreadPool* pool)
+{
+	_frame_cache = new FrameCache(options.cache_size);
+	for (int v = 0; v < _cameras_amount; ++v)
+	{
+		stringstream full_path;
+		full_path << _data_path << "cam" << (v + 1) << PATH_SEP;
+
+		// Marking the checkerboard corners needs a window, the cameras have to be calibrated already
+		if (!General::fexists(full_path.str() + General::VideoFile)
+			|| !(General::fexists(full_path.str() + General::BackgroundImageFile) || General::fexists(full_path.str() + General::BackgroundVideoFile))
+			|| !General::fexists(full_path.str() + General::ConfigFile))
+		{
+			cerr << "Missing the video, background or " << General::ConfigFile << " in " << full_path.str() << endl;
+			return false;
+		}
+
+		_cameras.push_back(new Camera(full_path.str(), General::ConfigFile, v));
+		if (!_cameras.back()->initialize()) return false;
+		_cameras.back()->setPrefetch(options.prefetch);
+		_cameras.back()->setFrameCache(_frame_cache);
+	}
+
+	// Voxel space from checkerboard.xml, overridden by the command line
+	VolumeConfig volume;
+	volume.read(_data_path + General::CBConfigFile);
+	if (!volume.parse(argc, argv) || !volume.validate()) return false;
+
+	_reconstructor = new Reconstructor(_cameras, _data_path, volume, pool);
+	_scene3d = new Scene3DRenderer(*_reconstructor, _cameras, false);
+	_scene3d->setSettings(options.settings);
+
+	_tracker = new Tracker(_cameras, _data_path, *_scene3d);
+	_tracker->setInteractive(false);
+	_tracker->setActive(options.track);
+
+	_pipeline = new FramePipeline(*_scene3d);
+
+	_voxels_file.open((_output_path + General::ReconstructionFile).c_str(), ios::out | ios::binary | ios::trunc);
+	if (options.track) _track_file.open((_output_path + General::TrackFile).c_str(), ios::out | ios::trunc);
+	if (!_voxels_file.is_open() || (options.track && !_track_file.is_open()))
+	{
+		cerr << "Unable to write to: " << _output_path << endl;
+		return false;
+	}
+
+	// Same frames as the interactive playback: 0 to the second last
+	_frame = 0;
+	_frames = (int) _scene3d->getNumberOfFrames() - 1;
+	_start = getTickCount();
+	_good = true;
+
+	return true;
+}
+
+/**
+ * Reconstruct (and track) all frames and write them, on this thread while the pipeline decodes, segments
+ * and carves the next ones on its own threads (their per frame loops on the pool). Returns whether all
+ * frames were written.
+ */
+bool ProcessingContext::run()
+{
+	if (!_good) return false;
+
+	_pipeline->start(_frame);
+	while (processFrame())
+		;
+	_pipeline->stop();
+
+	return _good && _frame == _frames;
+}
+
+/**
+ * Track and write the next frame out of the pipeline, returns false once all frames are done
+ */
+bool ProcessingContext::processFrame()
+{
+	if (!_good || _frame >= _frames) return false;
+
+	FrameJob* job = _pipeline->next();
+	if (job == NULL)
+	{
+		_good = false;
+		return false;
+	}
+	assert(job->frame == _frame);
+
+	_pipeline->commit(job);
+	_scene3d->setCurrentFrame(_frame);
+	if (_tracker->isActive())
+	{
+		_tracker->update();
+		if (_tracker->isActive())
+		{
+			_track_file << _frame << "\t";
+			_tracker->writeTrack(_track_file);
+		}
+	}
+	writeVoxels(_voxels_file, _frame, _reconstructor->getVisibleVoxels());
+	_scene3d->setPreviousFrame(_frame);
+	_pipeline->release(job);
+
+	++_frame;
+	if (_frame % 100 == 0) cout << _data_path << ": frame " << _frame << "/" << _frames << endl;
+
+	_good = _voxels_file.good() && (!_track_file.is_open() || _track_file.good());
+	return _good && _frame < _frames;
+}
+
+/**
+ * Close the output files, returns whether all frames were written
+ */
+bool ProcessingContext::finish()
+{
+	if (_voxels_file.is_open())
+	{
+		const double seconds = (getTickCount() - _start) / getTickFrequency();
+		cout << _data_path << ": " << _frame << " frames in " << seconds << "s (" << _frame / seconds << " fps), written to "
+			<< _output_path << endl;
+	}
+
+	_voxels_file.close();
+	_track_file.close();
+
+	return _good && _frame == _frames;
+}
+
+/**
+ * Append the visible voxels of a frame
+ */
+void ProcessingContext::writeVoxels(ostream &output, int frame_number, const vector<Reconstructor::Voxel> &voxels)
+{
+	vector<int32_t> record(2 + 3 * voxels.size());
+	record[0] = frame_number;
+	record[1] = (int32_t) voxels.size();
+	for (size_t v = 0; v < voxels.size(); ++v)
+	{
+		record[2 + 3 * v] = voxels[v].getX();
+		record[3 + 3 * v] = voxels[v].getY();
+		record[4 + 3 * v] = voxels[v].getZ();
+	}
+	output.write((const char*) &record[0], record.size() * sizeof(int32_t));
+}
+
+} /* namespace nl_uu_science_gmt */
@@ -0,0 +1,107 @@
+/*
+ * ProcessingOptions.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: Ulisse Bordignon, Nicola Chinellato
+ */
+
+#include "ProcessingOptions.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+namespace nl_uu_science_gmt
+{
+
+/**
+ * The defaults: 8 frames prefetch, 512 MB frame cache, the sliders at 0, no adaptive background, no tracking
+ */
+ProcessingOptions::ProcessingOptions() :
+		prefetch(8), cache_size((size_t) 512 << 20), track(false)
+{
+	settings.h_threshold = settings.s_threshold = settings.v_threshold = 0;
+	settings.e_d_selection = settings.e_d_number = 0;
+	settings.adaptive = false;
+	settings.incremental = false;
+	settings.octree = false;
+}
+
+/**
+ * Override the defaults with --prefetch, --cache, --hsv, --ed, --adaptive and --track, tells what's wrong
+ * with a value and returns false if one is malformed or out of range
+ */
+bool ProcessingOptions::parse(int argc, char** argv)
+{
+	for (int a = 1; a < argc; ++a)
+	{
+		const string option = argv[a];
+		if (option == "--adaptive")
+		{
+			settings.adaptive = true;
+			continue;
+		}
+		if (option == "--track")
+		{
+			track = true;
+			continue;
+		}
+		if (option != "--prefetch" && option != "--cache" && option != "--hsv" && option != "--ed") continue;
+
+		if (a + 1 >= argc)
+		{
+			cerr << option << " expects a value" << endl;
+			return false;
+		}
+		const char* value = argv[++a];
+		int v[3];
+		char end;
+		if (option == "--prefetch")
+		{
+			if (sscanf(value, "%d%c", &v[0], &end) != 1 || v[0] < 1)
+			{
+				cerr << "--prefetch expects a positive amount of frames, not: " << value << endl;
+				return false;
+			}
+			prefetch = v[0];
+		}
+		else if (option == "--cache")
+		{
+			if (sscanf(value, "%d%c", &v[0], &end) != 1 || v[0] < 0)
+			{
+				cerr << "--cache expects a non-negative amount of MB, not: " << value << endl;
+				return false;
+			}
+			cache_size = (size_t) v[0] << 20;
+		}
+		else if (option == "--hsv")
+		{
+			if (sscanf(value, "%d,%d,%d%c", &v[0], &v[1], &v[2], &end) != 3
+				|| *std::min_element(v, v + 3) < 0 || *std::max_element(v, v + 3) > 255)
+			{
+				cerr << "--hsv expects <h>,<s>,<v>, each 0 to 255, not: " << value << endl;
+				return false;
+			}
+			settings.h_threshold = v[0];
+			settings.s_threshold = v[1];
+			settings.v_threshold = v[2];
+		}
+		else
+		{
+			if (sscanf(value, "%d,%d%c", &v[0], &v[1], &end) != 2 || v[0] < 0 || v[0] > 1 || v[1] < 0 || v[1] > 15)
+			{
+				cerr << "--ed expects <0 erode|1 dilate first>,<rounds 0 to 15>, not: " << value << endl;
+				return false;
+			}
+			settings.e_d_selection = v[0];
+			settings.e_d_number = v[1];
+		}
+	}
+
+	return true;
+}
+
+} /* namespace nl_uu_science_gmt */
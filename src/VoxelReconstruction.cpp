@@ -90,31 +90,71 @@ namespace nl_uu_science_gmt
 		cout << "o       : Show/hide origin" << endl;
 		cout << "t       : Top view" << endl;
 		cout << "h       : HSV optimization (takes a LONG time)" << endl;
+		cout << "u       : Incremental reconstruction on/off" << endl;
+		cout << "x       : Octree carving on/off" << endl;
+		cout << "a       : Adaptive background on/off" << endl;
 		cout << "1,2,3,4 : Switch camera #" << endl << endl;
 		cout << "Zoom with the scrollwheel while on the 3D scene" << endl;
 		cout << "Rotate the 3D scene with left click+drag" << endl << endl;
+		cout << "Command line options (voxel space also as VoxelStep, VoxelVolume and VoxelROI in checkerboard.xml):" << endl;
+		cout << "--step <mm>" << endl;
+		cout << "--volume <x_min>,<x_max>,<y_min>,<y_max>,<z_min>,<z_max>" << endl;
+		cout << "--roi <x_min>,<x_max>,<y_min>,<y_max>,<z_min>,<z_max>" << endl;
+		cout << "--prefetch <frames>: frames decoded ahead per camera (default 8)" << endl;
+		cout << "--cache <MB>: memory for decoded frames revisited while scrubbing (default 512)" << endl;
+		cout << "--data <path>: data path of the camera rig, repeat for several rigs (default data/)" << endl;
+		cout << "--cameras <amount>: camera views per rig (default 4)" << endl;
+		cout << "--threads <amount>: worker threads shared by all rigs (default one per CPU)" << endl;
+		cout << "--affinity <cpus>: pin the workers round robin to these CPUs, eg. 0-3,8 (default unpinned)" << endl;
+		cout << "--cv-threads <amount>: threads of OpenCV's own parallel loops (default 0, sequential)" << endl;
+		cout << "--headless: process all frames of all rigs without windows, writes " << General::ReconstructionFile
+			<< " and " << General::TrackFile << " per rig" << endl;
+		cout << "  --output <path>: directory for those (default the data path of the rig)" << endl;
+		cout << "  --hsv <h>,<s>,<v>: foreground thresholds, 0 to 255 (the H, S and V sliders)" << endl;
+		cout << "  --ed <0 erode|1 dilate first>,<rounds 0 to 15>: morphology (the E/D sliders)" << endl;
+		cout << "  --adaptive: adaptive background" << endl;
+		cout << "  --track: track with " << CM_FILENAME << endl << endl;
 	}
 
 	/**
 	* - If the xml-file with camera intrinsics, extrinsics and distortion is missing,
 	*   create it from the checkerboard video and the measured camera intrinsics
-	* - After that initialize the scene rendering classes
-	* - Run it!
+	* - Read the voxel space from the command line, set the decoding options
 	*/
-	void VoxelReconstruction::run(int argc, char** argv)
+	bool VoxelReconstruction::setup(int argc, char** argv, const ProcessingOptions &options, VolumeConfig &volume)
 	{
 		for (int v = 0; v < _cam_views_amount; ++v)
 		{
 			bool has_cam = Camera::detExtrinsics(_cam_views[v]->getDataPath(), General::CheckerboadVideo,
 				General::IntrinsicsFile, _cam_views[v]->getCamPropertiesFile());
 			if (has_cam) has_cam = _cam_views[v]->initialize();
-			assert(has_cam);
+			if (!has_cam) return false;
+			_cam_views[v]->setPrefetch(options.prefetch);
 		}
 
+		// Voxel space from checkerboard.xml, overridden by the command line
+		volume.read(_data_path + General::CBConfigFile);
+		return volume.parse(argc, argv) && volume.validate();
+	}
+
+	/**
+	* - Initialize the cameras and the scene rendering classes, the per frame loops run on 'pool', if any
+	* - Run it!
+	* Returns false if the cameras or the command line options are unusable
+	*/
+	bool VoxelReconstruction::run(int argc, char** argv, const ProcessingOptions &options, ThreadPool* pool)
+	{
+		VolumeConfig volume;
+		if (!setup(argc, argv, options, volume)) return false;
+
 		destroyAllWindows();
 		namedWindow(VIDEO_WINDOW, CV_WINDOW_KEEPRATIO);
 
-		Reconstructor reconstructor(_cam_views, _data_path);
+		FrameCache frame_cache(options.cache_size);
+		for (int v = 0; v < _cam_views_amount; ++v)
+			_cam_views[v]->setFrameCache(&frame_cache);
+
+		Reconstructor reconstructor(_cam_views, _data_path, volume, pool);
 		Scene3DRenderer scene3d(reconstructor, _cam_views);
 		Tracker tracker(_cam_views, _data_path, scene3d);
 		Glut glut(scene3d, tracker);
@@ -125,6 +165,8 @@ namespace nl_uu_science_gmt
 		glut.initializeWindows(SCENE_WINDOW.c_str());
 		glut.mainLoopWindows();
 #endif
+
+		return true;
 	}
 
 } /* namespace nl_uu_science_gmt */
@@ -7,9 +7,11 @@
 
 #include "General.h"
 #include "Camera.h"
+#include "ForegroundKernel.h"
 
 #include <opencv2/opencv.hpp>
 #include <stddef.h>
+#include <algorithm>
 #include <cassert>
 #include <iostream>
 #include <sstream>
@@ -22,7 +24,6 @@ using namespace cv;
 namespace nl_uu_science_gmt
 {
 
-vector<Point>* Camera::_BoardCorners;  // marked checkerboard corners
 
 Camera::Camera(const string &dp, const string &cp, const int id) :
 		_data_path(dp), _cam_prop(cp), _id(id)
@@ -34,10 +35,39 @@ Camera::Camera(const string &dp, const string &cp, const int id) :
 	_px = 0;
 	_py = 0;
 	_frames = 0;
+
+	std::fill(_extrinsics, _extrinsics + 12, 0.f);
+	std::fill(_projection, _projection + 12, 0.f);
+	std::fill(_distortion, _distortion + 8, 0.f);
+	_distorted = false;
+	_cv_distortion = false;
+
+	_position = 0;
+	_cache = NULL;
+	_frame_number = -1;
+	_stream_frame = -1;
+	_reposition = false;
+	_prefetch = 8;
+	_ring_head = 0;
+	_ring_count = 0;
+	_ring_generation = 0;
+	_seek_frame = -1;
+	_ring_end = false;
+	_decode_stop = false;
+	_frame_requested = false;
 }
 
 Camera::~Camera()
 {
+	if (_decoder.joinable())
+	{
+		{
+			lock_guard<mutex> lock(_decode_mutex);
+			_decode_stop = true;
+		}
+		_decode_condition.notify_all();
+		_decoder.join();
+	}
 }
 
 /**
@@ -79,10 +109,9 @@ bool Camera::initialize()
 	}
 	assert(!bg_image.empty());
 
-	// Disect the background image in HSV-color space
-	Mat bg_hsv_im;
-	cvtColor(bg_image, bg_hsv_im, CV_BGR2HSV);
-	split(bg_hsv_im, _bg_hsv_channels);
+	// Convert the background image to interleaved HSV for the foreground kernel
+	ForegroundKernel::toBackground(bg_image, _bg_hsv);
+	ForegroundKernel::initModel(_bg_hsv, _bg_model);
 
 	// Open the video for this camera
 	_video = VideoCapture(_data_path + General::VideoFile);
@@ -93,14 +122,22 @@ bool Camera::initialize()
 	_plane_size.height = (int) _video.get(CV_CAP_PROP_FRAME_HEIGHT);
 	assert(_plane_size.area() > 0);
 
-	// Get the amount of video frames
-	_video.set(CV_CAP_PROP_POS_AVI_RATIO, 1);  // Go to the end of the video; 1 = 100%
-	_frames = (long) _video.get(CV_CAP_PROP_POS_FRAMES);
-	assert(_frames > 1);
-	_video.set(CV_CAP_PROP_POS_AVI_RATIO, 0);  // Go back to the start
+	// Get the amount of video frames and the keyframes, from the (cached) index if the video has one
+	if (_index.open(_data_path + General::VideoFile, _data_path + General::VideoIndexFile))
+	{
+		_frames = _index.getFramesAmount();
+	}
+	else
+	{
+		_video.set(CV_CAP_PROP_POS_AVI_RATIO, 1);  // Go to the end of the video; 1 = 100%
+		_frames = (long) _video.get(CV_CAP_PROP_POS_FRAMES);
+		_video.set(CV_CAP_PROP_POS_AVI_RATIO, 0);  // Go back to the start
 
-	_video.release(); //Re-open the file because _video.set(CV_CAP_PROP_POS_AVI_RATIO, 1) may screw it up
-	_video = cv::VideoCapture(_data_path + General::VideoFile);
+		_video.release(); //Re-open the file because _video.set(CV_CAP_PROP_POS_AVI_RATIO, 1) may screw it up
+		_video = cv::VideoCapture(_data_path + General::VideoFile);
+	}
+	assert(_frames > 1);
+	_position = 0;
 
 	// Read the camera properties (XML)
 	FileStorage fs;
@@ -124,6 +161,8 @@ bool Camera::initialize()
 		_fy = *_camera_matrix.ptr<float>(1, 1);
 		_px = *_camera_matrix.ptr<float>(0, 2);
 		_py = *_camera_matrix.ptr<float>(1, 2);
+
+		initProjection();
 	}
 	else
 	{
@@ -142,17 +181,112 @@ bool Camera::initialize()
  */
 Mat& Camera::advanceVideoFrame()
 {
-	_video >> _frame;
-	assert(!_frame.empty());
+	_frame_number = readVideoFrame(_frame);
 	return _frame;
 }
 
 /**
- * Set the video location to the given frame number
+ * Read the next frame from the video into 'frame' (its buffer is recycled), returns its frame number
+ *
+ * Only this function touches the video stream, so a frame pipeline can read into its own buffers
+ * while the current frame (getFrame()) is being shown. Only frames read after setVideoFrame() (scrubbing,
+ * picking a frame) go into the cache, playback in order doesn't pay for a copy of every frame.
+ */
+int Camera::readVideoFrame(Mat &frame)
+{
+	const bool repositioned = _reposition;
+	if (_reposition)
+	{
+		// Revisited frames come from the cache, the video is only repositioned for a frame that isn't cached
+		if (_cache != NULL && _cache->get(_id, _stream_frame + 1, frame))
+			return ++_stream_frame;
+
+		positionVideo(_stream_frame + 1);
+		_reposition = false;
+	}
+
+	if (_decoder.joinable())
+	{
+		_stream_frame = popVideoFrame(frame);
+	}
+	else
+	{
+		_stream_frame = _position;
+		_video >> frame;
+		++_position;
+	}
+	assert(!frame.empty());
+
+	if (_cache != NULL && repositioned) _cache->put(_id, _stream_frame, frame);
+	return _stream_frame;
+}
+
+/**
+ * Set the video location to the given frame number, the video itself is only
+ * repositioned when the next frame isn't cached
  */
 void Camera::setVideoFrame(int frame_number)
 {
-	_video.set(CV_CAP_PROP_POS_FRAMES, frame_number);
+	_stream_frame = frame_number - 1;
+	_reposition = true;
+}
+
+/**
+ * Make 'frame' (with number 'frame_number') the current frame, 'frame' gets the previous buffer
+ */
+void Camera::swapFrame(Mat &frame, int frame_number)
+{
+	std::swap(_frame, frame);
+	_frame_number = frame_number;
+}
+
+/**
+ * Position the video (or the decode thread) on the given frame
+ */
+void Camera::positionVideo(int frame_number)
+{
+	if (_decoder.joinable())
+	{
+		// Drop the frames read ahead and let the decode thread seek, unless the frame is next in line
+		{
+			lock_guard<mutex> lock(_decode_mutex);
+			if (_ring_count > 0 && _ring_frames[_ring_head] == frame_number) return;
+
+			_seek_frame = frame_number;
+			++_ring_generation;
+			_ring_count = 0;
+			_ring_end = false;
+		}
+		_decode_condition.notify_all();
+		return;
+	}
+
+	seekVideo(frame_number);
+}
+
+/**
+ * Position the video on the given frame: seek to the last keyframe before it and skip forward from there,
+ * skipping only if the frame is ahead in the current group of pictures
+ */
+void Camera::seekVideo(int frame_number)
+{
+	if (_index.isEmpty())
+	{
+		_video.set(CV_CAP_PROP_POS_FRAMES, frame_number);
+		_position = frame_number;
+		return;
+	}
+
+	const int keyframe = _index.getKeyframe(frame_number);
+	if (frame_number < _position || keyframe > _position)
+	{
+		_video.set(CV_CAP_PROP_POS_FRAMES, keyframe);
+		_position = keyframe;
+	}
+
+	// grab() doesn't convert the skipped frames
+	while (_position < frame_number && _video.grab())
+		++_position;
 }
 
 /**
@@ -164,26 +298,136 @@ Mat& Camera::getVideoFrame(int frame_number)
 	return advanceVideoFrame();
 }
 
+/**
+ * Start decoding ahead on a separate thread, from then on only the decode thread reads the video
+ */
+void Camera::startDecoder()
+{
+	if (_decoder.joinable()) return;
+
+	_ring.resize(std::max(1, _prefetch));
+	_ring_frames.assign(_ring.size(), -1);
+	_ring_head = 0;
+	_ring_count = 0;
+	_decoder = thread(&Camera::decode, this);
+}
+
+/**
+ * Decode thread: fill the free ring slots with the next frames, seek when asked to
+ */
+void Camera::decode()
+{
+	unique_lock<mutex> lock(_decode_mutex);
+	for (;;)
+	{
+		_decode_condition.wait(lock, [this]
+		{	return _decode_stop || _seek_frame >= 0 || (!_ring_end && _ring_count < _ring.size());});
+		if (_decode_stop) return;
+
+		const int seek_frame = _seek_frame;
+		_seek_frame = -1;
+		const unsigned int generation = _ring_generation;
+
+		// The free slot after the queued frames, the consumer never touches it
+		const size_t slot_index = (_ring_head + _ring_count) % _ring.size();
+		Mat &slot = _ring[slot_index];
+		lock.unlock();
+
+		if (seek_frame >= 0) seekVideo(seek_frame);
+		const int frame_number = _position;
+		_video >> slot;  // reuses the slot's buffer
+		++_position;
+
+		lock.lock();
+		if (generation != _ring_generation) continue;  // seeked meanwhile
+
+		if (slot.empty())
+		{
+			_ring_end = true;
+		}
+		else
+		{
+			_ring_frames[slot_index] = frame_number;
+			++_ring_count;
+		}
+		_decode_condition.notify_all();
+	}
+}
+
+/**
+ * Take the oldest decoded frame from the ring into 'frame', its previous buffer goes back into the ring,
+ * returns the frame number (-1 at the end of the video)
+ */
+int Camera::popVideoFrame(Mat &frame)
+{
+	int frame_number = -1;
+	{
+		unique_lock<mutex> lock(_decode_mutex);
+		_decode_condition.wait(lock, [this]
+		{	return _ring_count > 0 || (_ring_end && _seek_frame < 0);});
+
+		if (_ring_count > 0)
+		{
+			std::swap(frame, _ring[_ring_head]);
+			frame_number = _ring_frames[_ring_head];
+			_ring_head = (_ring_head + 1) % _ring.size();
+			--_ring_count;
+		}
+		else
+		{
+			frame.release();
+		}
+	}
+	_decode_condition.notify_all();
+
+	return frame_number;
+}
+
+/**
+ * Ask for the next frame (-1) or the given frame number, the frame is available through waitVideoFrame()
+ */
+void Camera::requestVideoFrame(int frame_number)
+{
+	startDecoder();
+	if (frame_number >= 0) setVideoFrame(frame_number);
+	_frame_requested = true;
+}
+
+/**
+ * Wait for the frame asked for with requestVideoFrame(), returns the current frame if nothing was requested
+ */
+Mat& Camera::waitVideoFrame()
+{
+	if (_frame_requested)
+	{
+		_frame_requested = false;
+		advanceVideoFrame();
+	}
+	return _frame;
+}
+
 /**
  * Handle mouse events
  */
 void Camera::onMouse(int event, int x, int y, int flags, void* param)
 {
+	vector<Point> &board_corners = *(vector<Point>*) param;  // marked checkerboard corners
+
 	switch (event)
 	{
 	case EVENT_LBUTTONDOWN:
 		if (flags == (EVENT_FLAG_LBUTTON + EVENT_FLAG_CTRLKEY))
 		{
-			if (!_BoardCorners->empty())
+			if (!board_corners.empty())
 			{
-				cout << "Removed corner " << _BoardCorners->size() << "... (use Click to add)" << endl;
-				_BoardCorners->pop_back();
+				cout << "Removed corner " << board_corners.size() << "... (use Click to add)" << endl;
+				board_corners.pop_back();
 			}
 		}
 		else
 		{
-			_BoardCorners->push_back(Point(x, y));
-			cout << "Added corner " << _BoardCorners->size() << "... (use CTRL+Click to remove)" << endl;
+			board_corners.push_back(Point(x, y));
+			cout << "Added corner " << board_corners.size() << "... (use CTRL+Click to remove)" << endl;
 		}
 		break;
 	default:
@@ -253,7 +497,7 @@ bool Camera::detExtrinsics(const string &data_path, const string &checker_vid_fn
 		cap >> frame;
 	assert(!frame.empty());
 
-	_BoardCorners = new vector<Point>(); //A pointer because we need access to it from static function onMouse
+	vector<Point> board_corners;  // marked checkerboard corners, also by onMouse
 
 	string corners_file = data_path + General::CheckerboadCorners;
 	if (General::fexists(corners_file))
@@ -273,10 +517,10 @@ bool Camera::detExtrinsics(const string &data_path, const string &checker_vid_fn
 				vector<int> corner;
 				fs[corner_id.str()] >> corner;
 				assert(corner.size() == 2);
-				_BoardCorners->push_back(Point(corner[0], corner[1]));
+				board_corners.push_back(Point(corner[0], corner[1]));
 			}
 
-			assert((int ) _BoardCorners->size() == board_size.area());
+			assert((int ) board_corners.size() == board_size.area());
 
 			fs.release();
 		}
@@ -285,20 +529,20 @@ bool Camera::detExtrinsics(const string &data_path, const string &checker_vid_fn
 	{
 		cout << "Estimate camera extrinsics by hand..." << endl;
 		namedWindow(MAIN_WINDOW, CV_WINDOW_KEEPRATIO);
-		setMouseCallback(MAIN_WINDOW, onMouse);
+		setMouseCallback(MAIN_WINDOW, onMouse, &board_corners);
 
 		cout << "Now mark the " << board_size.area() << " interior corners of the checkerboard" << endl;
 		Mat canvas;
-		while ((int) _BoardCorners->size() < board_size.area())
+		while ((int) board_corners.size() < board_size.area())
 		{
 			canvas = frame.clone();
 
-			if (!_BoardCorners->empty())
+			if (!board_corners.empty())
 			{
-				for (size_t c = 0; c < _BoardCorners->size(); c++)
+				for (size_t c = 0; c < board_corners.size(); c++)
 				{
-					circle(canvas, _BoardCorners->at(c), 4, Color_MAGENTA, 1, 8);
-					if (c > 0) line(canvas, _BoardCorners->at(c), _BoardCorners->at(c - 1), Color_MAGENTA, 1, 8);
+					circle(canvas, board_corners.at(c), 4, Color_MAGENTA, 1, 8);
+					if (c > 0) line(canvas, board_corners.at(c), board_corners.at(c - 1), Color_MAGENTA, 1, 8);
 				}
 			}
 
@@ -309,13 +553,13 @@ bool Camera::detExtrinsics(const string &data_path, const string &checker_vid_fn
 			}
 			else if (key == 'c' || key == 'C')
 			{
-				_BoardCorners->pop_back();
+				board_corners.pop_back();
 			}
 
 			imshow(MAIN_WINDOW, canvas);
 		}
 
-		assert((int ) _BoardCorners->size() == board_size.area());
+		assert((int ) board_corners.size() == board_size.area());
 		cout << "Marking finished!" << endl;
 		destroyAllWindows();
 
@@ -323,12 +567,12 @@ bool Camera::detExtrinsics(const string &data_path, const string &checker_vid_fn
 		fs.open(corners_file, FileStorage::WRITE);
 		if (fs.isOpened())
 		{
-			fs << "CornersAmount" << (int) _BoardCorners->size();
-			for (size_t b = 0; b < _BoardCorners->size(); ++b)
+			fs << "CornersAmount" << (int) board_corners.size();
+			for (size_t b = 0; b < board_corners.size(); ++b)
 			{
 				stringstream corner_id;
 				corner_id << "Corner_" << b;
-				fs << corner_id.str() << _BoardCorners->at(b);
+				fs << corner_id.str() << board_corners.at(b);
 			}
 			fs.release();
 		}
@@ -345,11 +589,9 @@ bool Camera::detExtrinsics(const string &data_path, const string &checker_vid_fn
 		float z = 0;
 
 		object_points.push_back(Point3f(x, y, z));
-		image_points.push_back(_BoardCorners->at(s));
+		image_points.push_back(board_corners.at(s));
 	}
 
-	delete _BoardCorners;
-
 	Mat rotation_values_d, translation_values_d;
 	solvePnP(object_points, image_points, camera_matrix, distortion_coeffs, rotation_values_d, translation_values_d);
 
@@ -494,12 +736,127 @@ cv::Point Camera::projectOnView(const cv::Point3f &coords, const cv::Mat &rotati
 	return image_points.front();
 }
 
+/**
+ * Hash of the intrinsics, extrinsics and image size of this camera,
+ * used to detect that a stored LUT no longer fits the calibration
+ */
+uint64_t Camera::getCalibrationHash() const
+{
+	uint64_t h = General::hash(&_plane_size.width, sizeof(int));
+	h = General::hash(&_plane_size.height, sizeof(int), h);
+
+	const Mat* calibration[] = { &_camera_matrix, &_distortion_coeffs, &_rotation_values, &_translation_values };
+	for (size_t m = 0; m < sizeof(calibration) / sizeof(calibration[0]); ++m)
+	{
+		const Mat values = calibration[m]->isContinuous() ? *calibration[m] : calibration[m]->clone();
+		if (!values.empty()) h = General::hash(values.data, values.total() * values.elemSize(), h);
+	}
+
+	return h;
+}
+
 /**
  * Non-static for backwards compatibility
  */
 Point Camera::projectOnView(const Point3f &coords)
 {
-	return projectOnView(coords, _rotation_values, _translation_values, _camera_matrix, _distortion_coeffs);
+	if (_cv_distortion) return projectOnView(coords, _rotation_values, _translation_values, _camera_matrix, _distortion_coeffs);
+	return _distorted ? projectDistorted(coords) : projectPinhole(coords);
+}
+
+/**
+ * Precompute the [R|t] and K[R|t] matrices and the distortion coefficients as plain floats,
+ * so projecting doesn't redo the Rodrigues conversion nor go through cv::Mat
+ */
+void Camera::initProjection()
+{
+	Mat rotation;
+	Rodrigues(_rotation_values, rotation);
+	rotation.convertTo(rotation, CV_32F);
+
+	for (int r = 0; r < 3; ++r)
+	{
+		for (int c = 0; c < 3; ++c)
+			_extrinsics[r * 4 + c] = rotation.at<float>(r, c);
+		_extrinsics[r * 4 + 3] = _translation_values.at<float>(r);
+	}
+
+	// K[R|t], the skew of K is ignored just like cv::projectPoints does
+	for (int c = 0; c < 4; ++c)
+	{
+		_projection[c] = _fx * _extrinsics[c] + _px * _extrinsics[8 + c];
+		_projection[4 + c] = _fy * _extrinsics[4 + c] + _py * _extrinsics[8 + c];
+		_projection[8 + c] = _extrinsics[8 + c];
+	}
+
+	std::fill(_distortion, _distortion + 8, 0.f);
+	const int coefficients = (int) _distortion_coeffs.total();
+	_cv_distortion = coefficients > 8;
+	for (int i = 0; i < std::min(coefficients, 8); ++i)
+		_distortion[i] = _distortion_coeffs.at<float>(i);
+
+	// Distortion is negligible when it moves none of the image corners by more than a tenth of a pixel
+	_distorted = _cv_distortion;
+	const float corners[4][2] = { { 0, 0 }, { (float) _plane_size.width, 0 }, { 0, (float) _plane_size.height },
+			{ (float) _plane_size.width, (float) _plane_size.height } };
+	for (int i = 0; i < 4 && !_distorted && _fx > 0 && _fy > 0; ++i)
+	{
+		// a point on the camera's z = 1 plane that projects on the corner without distortion
+		const float x = (corners[i][0] - _px) / _fx;
+		const float y = (corners[i][1] - _py) / _fy;
+		const float z = 1;
+
+		// back to world coordinates: R^T * (p - t)
+		const float* E = _extrinsics;
+		const float dx = x - E[3], dy = y - E[7], dz = z - E[11];
+		const Point3f world(E[0] * dx + E[4] * dy + E[8] * dz, E[1] * dx + E[5] * dy + E[9] * dz,
+				E[2] * dx + E[6] * dy + E[10] * dz);
+
+		const Point2f distorted = projectDistorted(world), pinhole = projectPinhole(world);
+		const float sx = distorted.x - pinhole.x, sy = distorted.y - pinhole.y;
+		_distorted = sx * sx + sy * sy > 0.01f;
+	}
+}
+
+/**
+ * Project a batch of 3D points on this camera's image plane in a single call
+ */
+void Camera::projectOnView(const vector<Point3f> &coords, vector<Point2f> &image_points) const
+{
+	image_points.resize(coords.size());
+	if (!coords.empty()) projectOnView(&coords[0], coords.size(), &image_points[0]);
+}
+
+/**
+ * Project 'amount' 3D points on this camera's image plane into 'image_points' (which must hold 'amount' points),
+ * same pinhole + distortion model as cv::projectPoints, without allocating and skipping negligible distortion
+ */
+void Camera::projectOnView(const Point3f* coords, size_t amount, Point2f* image_points) const
+{
+	if (_cv_distortion)
+	{
+		const Mat object_mat(1, (int) amount, CV_32FC3, (void*) coords);
+		Mat image_mat(1, (int) amount, CV_32FC2, image_points);
+		projectPoints(object_mat, _rotation_values, _translation_values, _camera_matrix, _distortion_coeffs, image_mat);
+		return;
+	}
+
+	if (_distorted)
+	{
+#ifdef _OPENMP
+#pragma omp simd
+#endif
+		for (int i = 0; i < (int) amount; ++i)
+			image_points[i] = projectDistorted(coords[i]);
+	}
+	else
+	{
+#ifdef _OPENMP
+#pragma omp simd
+#endif
+		for (int i = 0; i < (int) amount; ++i)
+			image_points[i] = projectPinhole(coords[i]);
+	}
 }
 
 } /* namespace nl_uu_science_gmt */
@@ -0,0 +1,197 @@
+/*
+ * FramePipeline.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: Ulisse Bordignon, Nicola Chinellato
+ */
+
+#include "FramePipeline.h"
+
+#include <cassert>
+
+#include "Camera.h"
+
+using namespace std;
+using namespace cv;
+
+namespace nl_uu_science_gmt
+{
+
+/**
+ * A pipeline with 'depth' frames in flight besides the one in every stage
+ */
+FramePipeline::FramePipeline(Scene3DRenderer &s3d, size_t depth) :
+		_scene3d(s3d), _jobs(depth + 4), _free(depth + 4), _decoded(depth + 4), _segmented(depth + 4),
+		_carved(depth + 4), _next_frame(0), _committed_frame(-1), _running(false)
+{
+	const size_t cameras = _scene3d.getCameras().size();
+	for (size_t j = 0; j < _jobs.size(); ++j)
+	{
+		_jobs[j].frame = -1;
+		_jobs[j].frames.resize(cameras);
+		_jobs[j].foregrounds.resize(cameras);
+	}
+}
+
+FramePipeline::~FramePipeline()
+{
+	stop();
+}
+
+/**
+ * Start playing from the given frame
+ */
+void FramePipeline::start(int frame_number)
+{
+	if (_running) return;
+
+	const vector<Camera*> &cameras = _scene3d.getCameras();
+	for (size_t c = 0; c < cameras.size(); ++c)
+	{
+		cameras[c]->startDecoder();
+		cameras[c]->setVideoFrame(frame_number);
+	}
+	_next_frame = frame_number;
+	_committed_frame = frame_number - 1;
+	_settings = _scene3d.getSettings();
+
+	_free.reset();
+	_decoded.reset();
+	_segmented.reset();
+	_carved.reset();
+	for (size_t j = 0; j < _jobs.size(); ++j)
+		_free.push(&_jobs[j]);
+
+	_running = true;
+	_decode_thread = thread(&FramePipeline::decode, this);
+	_segment_thread = thread(&FramePipeline::segment, this);
+	_carve_thread = thread(&FramePipeline::carve, this);
+}
+
+/**
+ * Stop all stages and drop the frames in flight, the videos continue after the last committed frame
+ */
+void FramePipeline::stop()
+{
+	if (!_running) return;
+
+	_free.close();
+	_decoded.close();
+	_segmented.close();
+	_carved.close();
+	_decode_thread.join();
+	_segment_thread.join();
+	_carve_thread.join();
+	_running = false;
+
+	const vector<Camera*> &cameras = _scene3d.getCameras();
+	for (size_t c = 0; c < cameras.size(); ++c)
+		cameras[c]->setVideoFrame(_committed_frame + 1);
+}
+
+/**
+ * The settings the frames decoded from now on are processed with, called by whoever changes them
+ */
+void FramePipeline::setSettings(const FrameSettings &settings)
+{
+	lock_guard<mutex> lock(_settings_mutex);
+	_settings = settings;
+}
+
+/**
+ * Decode stage: read the next frame of every camera, every camera decodes ahead on its own thread
+ */
+void FramePipeline::decode()
+{
+	const vector<Camera*> &cameras = _scene3d.getCameras();
+	const int last = (int) _scene3d.getNumberOfFrames() - 2;
+
+	FrameJob* job;
+	while (_free.pop(job))
+	{
+		// Go to the start of the video if we've moved beyond the end
+		if (_next_frame > last)
+		{
+			_next_frame = 0;
+			for (size_t c = 0; c < cameras.size(); ++c)
+				cameras[c]->setVideoFrame(_next_frame);
+		}
+
+		job->frame = _next_frame++;
+		{
+			lock_guard<mutex> lock(_settings_mutex);
+			job->settings = _settings;
+		}
+		for (size_t c = 0; c < cameras.size(); ++c)
+			cameras[c]->readVideoFrame(job->frames[c]);
+
+		if (!_decoded.push(job)) return;
+	}
+}
+
+/**
+ * Foreground stage: background subtraction and morphology for every camera
+ */
+void FramePipeline::segment()
+{
+	FrameJob* job;
+	while (_decoded.pop(job))
+	{
+		for (size_t c = 0; c < job->frames.size(); ++c)
+			_scene3d.processForeground(c, job->frames[c], job->frame, job->foregrounds[c], job->settings);
+
+		if (!_segmented.push(job)) return;
+	}
+}
+
+/**
+ * Carve stage: the visible voxels of the foregrounds
+ */
+void FramePipeline::carve()
+{
+	FrameJob* job;
+	while (_segmented.pop(job))
+	{
+		_scene3d.getReconstructor().reconstruct(job->foregrounds, job->voxels, job->settings.incremental,
+				job->settings.octree);
+
+		if (!_carved.push(job)) return;
+	}
+}
+
+/**
+ * Wait for the next finished frame, NULL if the pipeline stopped
+ */
+FrameJob* FramePipeline::next()
+{
+	FrameJob* job = NULL;
+	return _carved.pop(job) ? job : NULL;
+}
+
+/**
+ * Make a finished frame the current one: its video frames, foregrounds and visible voxels move into
+ * the cameras and the reconstructor, their previous buffers into the job
+ */
+void FramePipeline::commit(FrameJob* job)
+{
+	assert(job != NULL);
+
+	const vector<Camera*> &cameras = _scene3d.getCameras();
+	for (size_t c = 0; c < cameras.size(); ++c)
+	{
+		cameras[c]->swapFrame(job->frames[c], job->frame);
+		cameras[c]->swapForegroundImage(job->foregrounds[c]);
+	}
+	_scene3d.getReconstructor().swapVisibleVoxels(job->voxels);
+	_committed_frame = job->frame;
+}
+
+/**
+ * Give a committed job back for decoding the next frames into
+ */
+void FramePipeline::release(FrameJob* job)
+{
+	_free.push(job);
+}
+
+} /* namespace nl_uu_science_gmt */
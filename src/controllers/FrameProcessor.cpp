@@ -0,0 +1,132 @@
+/*
+ * FrameProcessor.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: Ulisse Bordignon, Nicola Chinellato
+ */
+
+#include "FrameProcessor.h"
+
+#include <stddef.h>
+
+#include "Camera.h"
+#include "Reconstructor.h"
+
+using namespace std;
+using namespace cv;
+
+namespace nl_uu_science_gmt
+{
+
+FrameProcessor::FrameProcessor(Scene3DRenderer &s3d, Tracker &t) :
+		_scene3d(s3d), _tracker(t), _pipeline(s3d), _front(0), _camera(0), _stop(false), _running(false), _interactive(true)
+{
+	_snapshots[0].frame = _snapshots[1].frame = -1;
+	_snapshots[0].camera = _snapshots[1].camera = 0;
+}
+
+FrameProcessor::~FrameProcessor()
+{
+	stop();
+}
+
+/**
+ * Start playing from the given frame
+ */
+void FrameProcessor::start(int frame_number)
+{
+	if (_running) return;
+
+	// No popups from the processing thread
+	_interactive = _tracker.isInteractive();
+	_tracker.setInteractive(false);
+
+	_pipeline.start(frame_number);
+	_stop = false;
+	_running = true;
+	_thread = thread(&FrameProcessor::run, this);
+}
+
+/**
+ * Stop playing, the cameras and the reconstructor keep the last published frame
+ */
+void FrameProcessor::stop()
+{
+	if (!_running) return;
+
+	_stop = true;
+	_thread.join();
+	_pipeline.stop();
+	_running = false;
+
+	_tracker.setInteractive(_interactive);
+}
+
+/**
+ * Processing thread: commit, track and publish every frame the pipeline finishes
+ */
+void FrameProcessor::run()
+{
+	while (!_stop)
+	{
+		FrameJob* job = _pipeline.next();
+		if (job == NULL) break;
+
+		_pipeline.commit(job);
+		if (_tracker.isActive())
+			_tracker.update();
+		_pipeline.release(job);
+
+		publish(_pipeline.getCommittedFrame());
+	}
+}
+
+/**
+ * Copy the current state of the cameras, the reconstructor and the tracker into the back buffer and
+ * make it the front one. Only called by whoever processes the frames: the processing thread while
+ * running, the caller otherwise.
+ */
+void FrameProcessor::publish(int frame_number)
+{
+	// Nobody but the publisher touches the back buffer
+	FrameSnapshot &snapshot = _snapshots[1 - _front];
+	snapshot.frame = frame_number;
+
+	const vector<Camera*> &cameras = _scene3d.getCameras();
+	snapshot.camera = _camera;
+	cameras[snapshot.camera]->getFrame().copyTo(snapshot.video);
+	cameras[snapshot.camera]->getForegroundImage().copyTo(snapshot.foreground);
+
+	const vector<Reconstructor::Voxel> &voxels = _scene3d.getReconstructor().getVisibleVoxels();
+	snapshot.voxels.resize(voxels.size());
+	snapshot.voxel_colors.resize(voxels.size());
+	for (size_t v = 0; v < voxels.size(); ++v)
+	{
+		snapshot.voxels[v] = Point3f((float) voxels[v].getX(), (float) voxels[v].getY(), (float) voxels[v].getZ());
+		snapshot.voxel_colors[v] = voxels[v].getColor();
+	}
+
+	snapshot.centers.clear();
+	snapshot.center_colors.clear();
+	if (_tracker.isActive())
+	{
+		snapshot.centers = _tracker.getRefinedCenters();
+		const vector<Tracker::ColorModel*> color_models = _tracker.getColorModels();
+		for (size_t m = 0; m < color_models.size(); ++m)
+			snapshot.center_colors.push_back(color_models[m]->color);
+	}
+
+	lock_guard<mutex> lock(_snapshot_mutex);
+	_front = 1 - _front;
+}
+
+/**
+ * The frame number of the front snapshot
+ */
+int FrameProcessor::getFrame()
+{
+	lock_guard<mutex> lock(_snapshot_mutex);
+	return _snapshots[_front].frame;
+}
+
+} /* namespace nl_uu_science_gmt */
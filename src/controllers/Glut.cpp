@@ -6,6 +6,7 @@
 */
 
 #include "Camera.h"
+#include "ForegroundKernel.h"
 #include "Glut.h"
 
 #ifdef __linux__
@@ -16,6 +17,7 @@
 #include <cmath>
 #include <cstdlib>
 #include <ctime>
+#include <mutex>
 #include <sstream>
 #include <string>
 #include <vector>
@@ -29,7 +31,7 @@ namespace nl_uu_science_gmt
 	Glut* Glut::_glut;
 
 	Glut::Glut(Scene3DRenderer &s3d, Tracker &trck) :
-		_scene3d(s3d), _tracker(trck)
+		_scene3d(s3d), _tracker(trck), _processor(s3d, trck)
 	{
 		// static pointer to this class so we can get to it from the static GL events
 		_glut = this;
@@ -241,9 +243,25 @@ namespace nl_uu_science_gmt
 	void Glut::quit()
 	{
 		_glut->getScene3d().setQuit(true);
+		_glut->getProcessor().stop();
 		exit(EXIT_SUCCESS);
 	}
 
+	/**
+	* Take the cameras, the reconstructor and the tracker back from the processing thread, at the last
+	* processed frame; the next update resumes playing if it should
+	*/
+	void Glut::stopProcessor()
+	{
+		FrameProcessor& processor = _glut->getProcessor();
+		if (!processor.isRunning()) return;
+
+		processor.stop();
+		Scene3DRenderer& scene3d = _glut->getScene3d();
+		scene3d.setPreviousFrame(processor.getFrame());
+		scene3d.setCurrentFrame(processor.getFrame());
+	}
+
 	/**
 	* Handle all keyboard input
 	*/
@@ -325,9 +343,31 @@ namespace nl_uu_science_gmt
 				bool record = General::popup("Optimization starting", "Record the process?");
 				optimizeHSV(record);
 			}
+			else if (key == 'u' || key == 'U')
+			{
+				stopProcessor();
+				Reconstructor& reconstructor = scene3d.getReconstructor();
+				reconstructor.setIncremental(!reconstructor.isIncremental());
+				cout << "Incremental reconstruction " << (reconstructor.isIncremental() ? "on" : "off") << endl;
+			}
+			else if (key == 'x' || key == 'X')
+			{
+				stopProcessor();
+				Reconstructor& reconstructor = scene3d.getReconstructor();
+				reconstructor.setOctree(!reconstructor.isOctree());
+				cout << "Octree carving " << (reconstructor.isOctree() ? "on" : "off") << endl;
+			}
+			else if (key == 'a' || key == 'A')
+			{
+				stopProcessor();
+				scene3d.setAdaptive(!scene3d.isAdaptive());
+				cout << "Adaptive background " << (scene3d.isAdaptive() ? "on" : "off") << endl;
+			}
 			else if (key == 'k' || key == 'K') {
+				// The processing thread updates (and may switch off) the tracker
+				stopProcessor();
 				tracker.toggleActive();
-				//tracker.update(vector<Reconstructor::Voxel*>());
+				//tracker.update(vector<Reconstructor::Voxel>());
 			}
 		}
 		else if (key_i > 0 && key_i <= (int)scene3d.getCameras().size())
@@ -573,6 +613,32 @@ namespace nl_uu_science_gmt
 			// Quit signaled
 			quit();
 		}
+
+		// The snapshots show the selected camera, in top view the last one selected
+		FrameProcessor& processor = _glut->getProcessor();
+		processor.setCamera(scene3d.getCurrentCamera() != -1 ? scene3d.getCurrentCamera() : scene3d.getPreviousCamera());
+
+		// Plain playback runs on the processing thread; the color models are made here, they need windows
+		const bool pipelined = !scene3d.isPaused() && !(tracker.isActive() && tracker.getColorModels().empty());
+		if (processor.isRunning())
+		{
+			if (!pipelined || scene3d.getCurrentFrame() != scene3d.getPreviousFrame())
+			{
+				// Paused, or moved to another frame: continue from the last processed frame
+				const bool moved = scene3d.getCurrentFrame() != scene3d.getPreviousFrame();
+				processor.stop();
+				scene3d.setPreviousFrame(processor.getFrame());
+				if (!moved) scene3d.setCurrentFrame(processor.getFrame());
+			}
+			else
+			{
+				// Show the latest processed frame, the next ones get the sliders as they are now
+				scene3d.setCurrentFrame(processor.getFrame());
+				scene3d.setPreviousFrame(scene3d.getCurrentFrame());
+				processor.setSettings(scene3d.getSettings());
+			}
+		}
+
 		if (scene3d.getCurrentFrame() > scene3d.getNumberOfFrames() - 2)
 		{
 			// Go to the start of the video if we've moved beyond the end
@@ -587,30 +653,41 @@ namespace nl_uu_science_gmt
 			for (size_t c = 0; c < scene3d.getCameras().size(); ++c)
 				scene3d.getCameras()[c]->setVideoFrame(scene3d.getCurrentFrame());
 		}
-		if (!scene3d.isPaused())
+		if (pipelined && !processor.isRunning() && scene3d.getCurrentFrame() == scene3d.getPreviousFrame())
 		{
-			// If not paused move to the next frame
-			scene3d.setCurrentFrame(scene3d.getCurrentFrame() + 1);
+			// Process the next frames at full speed, independent of this loop
+			processor.start(scene3d.getCurrentFrame() + 1);
 		}
-		if (scene3d.getCurrentFrame() != scene3d.getPreviousFrame())
+		if (!scene3d.isPaused() && !processor.isRunning())
 		{
-			// If the current frame is different from the last iteration update stuff
-			scene3d.processFrame();
-			scene3d.getReconstructor().update();
-			if (tracker.isActive())
-				tracker.update();
-			scene3d.setPreviousFrame(scene3d.getCurrentFrame());
+			// If not paused move to the next frame
+			scene3d.setCurrentFrame(scene3d.getCurrentFrame() + 1);
 		}
-		else if (scene3d.getHThreshold() != scene3d.getPHThreshold() || scene3d.getSThreshold() != scene3d.getPSThreshold()
-			|| scene3d.getVThreshold() != scene3d.getPVThreshold())
+		if (!processor.isRunning())
 		{
-			// Update the scene if one of the HSV sliders was moved (when the video is paused)
-			scene3d.processFrame();
-			scene3d.getReconstructor().update();
+			if (scene3d.getCurrentFrame() != scene3d.getPreviousFrame())
+			{
+				// If the current frame is different from the last iteration update stuff
+				scene3d.processFrame();
+				scene3d.getReconstructor().update();
+				if (tracker.isActive())
+					tracker.update();
+				scene3d.setPreviousFrame(scene3d.getCurrentFrame());
+			}
+			else if (scene3d.getHThreshold() != scene3d.getPHThreshold() || scene3d.getSThreshold() != scene3d.getPSThreshold()
+				|| scene3d.getVThreshold() != scene3d.getPVThreshold())
+			{
+				// Update the scene if one of the HSV sliders was moved (when the video is paused)
+				scene3d.processFrame();
+				scene3d.getReconstructor().update();
+
+				scene3d.setPHThreshold(scene3d.getHThreshold());
+				scene3d.setPSThreshold(scene3d.getSThreshold());
+				scene3d.setPVThreshold(scene3d.getVThreshold());
+			}
 
-			scene3d.setPHThreshold(scene3d.getHThreshold());
-			scene3d.setPSThreshold(scene3d.getSThreshold());
-			scene3d.setPVThreshold(scene3d.getVThreshold());
+			// The renderer only shows snapshots
+			processor.publish(scene3d.getPreviousFrame());
 		}
 
 		// Auto rotate the scene
@@ -619,28 +696,23 @@ namespace nl_uu_science_gmt
 			arcball_add_angle(2);
 		}
 
-		// Get the image and the foreground image (of set camera)
-		Mat canvas, foreground;
-		if (scene3d.getCurrentCamera() != -1)
-		{
-			canvas = scene3d.getCameras()[scene3d.getCurrentCamera()]->getFrame();
-			foreground = scene3d.getCameras()[scene3d.getCurrentCamera()]->getForegroundImage();
-		}
-		else
-		{
-			canvas = scene3d.getCameras()[scene3d.getPreviousCamera()]->getFrame();
-			foreground = scene3d.getCameras()[scene3d.getPreviousCamera()]->getForegroundImage();
-		}
-
-		// Concatenate the video frame with the foreground image (of set camera)
-		if (!canvas.empty() && !foreground.empty())
+		// Concatenate the video frame with the foreground image (of set camera), as last published
+		Mat canvas;
 		{
-			Mat fg_im_3c;
-			cvtColor(foreground, fg_im_3c, CV_GRAY2BGR);
-			hconcat(canvas, fg_im_3c, canvas);
-			imshow(VIDEO_WINDOW, canvas);
+			lock_guard<mutex> lock(processor.getSnapshotMutex());
+			const FrameSnapshot& snapshot = processor.getSnapshot();
+			if (!snapshot.video.empty() && !snapshot.foreground.empty())
+			{
+				Mat fg_im_3c;
+				cvtColor(snapshot.foreground, fg_im_3c, CV_GRAY2BGR);
+				hconcat(snapshot.video, fg_im_3c, canvas);
+			}
+			else if (!snapshot.video.empty())
+			{
+				canvas = snapshot.video.clone();
+			}
 		}
-		else if (!canvas.empty())
+		if (!canvas.empty())
 		{
 			imshow(VIDEO_WINDOW, canvas);
 		}
@@ -841,14 +913,16 @@ namespace nl_uu_science_gmt
 		glPointSize(2.0f);
 		glBegin(GL_POINTS);
 
-		vector<Reconstructor::Voxel*> voxels = _glut->getScene3d().getReconstructor().getVisibleVoxels();
-		for (size_t v = 0; v < voxels.size(); v++)
+		FrameProcessor& processor = _glut->getProcessor();
+		lock_guard<mutex> lock(processor.getSnapshotMutex());
+		const FrameSnapshot& snapshot = processor.getSnapshot();
+		for (size_t v = 0; v < snapshot.voxels.size(); v++)
 		{
 			// glColor4f(0.5f, 0.5f, 0.5f, 0.5f);
-			Scalar color = voxels[v]->color;
+			const Vec4f& color = snapshot.voxel_colors[v];
 
 			glColor4f(color[0], color[1], color[2], color[3]);
-			glVertex3f((GLfloat)voxels[v]->x, (GLfloat)voxels[v]->y, (GLfloat)voxels[v]->z);
+			glVertex3f((GLfloat)snapshot.voxels[v].x, (GLfloat)snapshot.voxels[v].y, (GLfloat)snapshot.voxels[v].z);
 		}
 
 		glEnd();
@@ -921,19 +995,20 @@ namespace nl_uu_science_gmt
 	}
 
 	void Glut::drawClustersCenters() {
-		Scene3DRenderer& scene3d = _glut->getScene3d();
-		Tracker& tracker = _glut->getTracker();
+		FrameProcessor& processor = _glut->getProcessor();
+		lock_guard<mutex> lock(processor.getSnapshotMutex());
+		const FrameSnapshot& snapshot = processor.getSnapshot();
 		
-		for (int i = 0; i < tracker.getRefinedCenters().size(); i++) {
-			vector<Point2f> centers = tracker.getRefinedCenters()[i];
-			Scalar color = tracker.getColorModels()[i]->color;
+		for (int i = 0; i < snapshot.centers.size() && i < snapshot.center_colors.size(); i++) {
+			const vector<Point2f>& centers = snapshot.centers[i];
+			Scalar color = snapshot.center_colors[i];
 
 			glLineWidth(1.5f);
 			glPushMatrix();
 			glBegin(GL_LINE_STRIP);
 			glColor4f(color[0], color[1], color[2], color[3]);
 
-			for (int j = 0; j < centers.size() && j < scene3d.getCurrentFrame(); j++) {
+			for (int j = 0; j < centers.size() && j < snapshot.frame; j++) {
 				glVertex3f(centers[j].x, centers[j].y, 0);
 			}
 
@@ -963,9 +1038,6 @@ namespace nl_uu_science_gmt
 		int frameNr = rand() % 19;
 
 		Mat frame = imread(dataPath + format("frame%i.jpg", frameNr));
-		// Convert to HSV space
-		Mat frameHSV;
-		cvtColor(frame, frameHSV, CV_BGR2HSV);
 
 		Mat groundtruth = imread(dataPath + format("frame%i_mask.jpg", frameNr), CV_LOAD_IMAGE_GRAYSCALE);
 		// Just because my Photoshop skills aren't the best and there are some grayish pixels on the maks files
@@ -983,8 +1055,12 @@ namespace nl_uu_science_gmt
 		Scalar bestValues(0, 0, 0);
 		int bestResult = 0;
 
-		vector<Mat> channels;
-		split(frameHSV, channels);
+		// The frame doesn't change, so its HSV differences with the background are computed once
+		Mat differences;
+		ThreadPool* pool = scene3d.getReconstructor().getPool();
+		ForegroundKernel::difference(frame, camera->getBgHsv(), differences, pool);
+		ForegroundKernel kernel;
+		kernel.setPool(pool);
 
 		bool quit = false;
 
@@ -1001,20 +1077,10 @@ namespace nl_uu_science_gmt
 		for (int s = 0; !quit && s < 255; s++) {
 			for (int v = 0; !quit && v < 255; v++) {
 
-				// Background subtraction H
-				Mat tmp, foreground, background;
-				absdiff(channels[0], camera->getBgHsvChannels().at(0), tmp);
-				threshold(tmp, foreground, h, 255, CV_THRESH_BINARY);
-
-				// Background subtraction S
-				absdiff(channels[1], camera->getBgHsvChannels().at(1), tmp);
-				threshold(tmp, background, s, 255, CV_THRESH_BINARY);
-				bitwise_and(foreground, background, foreground);
-
-				// Background subtraction V
-				absdiff(channels[2], camera->getBgHsvChannels().at(2), tmp);
-				threshold(tmp, background, v, 255, CV_THRESH_BINARY);
-				bitwise_or(foreground, background, foreground);
+				// Background subtraction HSV, only the thresholds change
+				Mat foreground;
+				kernel.setThresholds(h, s, v);
+				kernel.threshold(differences, foreground);
 
 				Mat difference;
 				absdiff(foreground, groundtruth, difference);
@@ -1048,20 +1114,10 @@ namespace nl_uu_science_gmt
 			for (int s = bestValues[1] - 15; !quit && s < bestValues[1] + 15; s++) {
 				for (int v = bestValues[2] - 15; !quit && v < bestValues[2] + 15; v++) {
 
-					// Background subtraction H
-					Mat tmp, foreground, background;
-					absdiff(channels[0], camera->getBgHsvChannels().at(0), tmp);
-					threshold(tmp, foreground, h, 255, CV_THRESH_BINARY);
-
-					// Background subtraction S
-					absdiff(channels[1], camera->getBgHsvChannels().at(1), tmp);
-					threshold(tmp, background, s, 255, CV_THRESH_BINARY);
-					bitwise_and(foreground, background, foreground);
-
-					// Background subtraction V
-					absdiff(channels[2], camera->getBgHsvChannels().at(2), tmp);
-					threshold(tmp, background, v, 255, CV_THRESH_BINARY);
-					bitwise_or(foreground, background, foreground);
+					// Background subtraction HSV, only the thresholds change
+					Mat foreground;
+					kernel.setThresholds(h, s, v);
+					kernel.threshold(differences, foreground);
 
 					Mat difference;
 					absdiff(foreground, groundtruth, difference);
@@ -9,7 +9,11 @@
 #include "Reconstructor.h"
 
 #include <opencv2/opencv.hpp>
+#include <algorithm>
 #include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 
 using namespace std;
@@ -18,11 +22,165 @@ using namespace cv;
 namespace nl_uu_science_gmt
 {
 
+	/**
+	* Default voxel space: 7.2m x 7.2m x 3.6m centered on the origin, with 5cm voxels
+	*/
+	VolumeConfig::VolumeConfig() :
+		x_min(-3600), x_max(3600), y_min(-3600), y_max(3600), z_min(0), z_max(3600), step(50), roi(false),
+		roi_x_min(0), roi_x_max(0), roi_y_min(0), roi_y_max(0), roi_z_min(0), roi_z_max(0)
+	{
+	}
+
+	/**
+	* Read the voxel space from an XML file (eg. checkerboard.xml), missing values are left as they are
+	* 	- VoxelStep: the voxel edge
+	* 	- VoxelVolume: x_min, x_max, y_min, y_max, z_min, z_max
+	* 	- VoxelROI: x_min, x_max, y_min, y_max, z_min, z_max
+	*/
+	void VolumeConfig::read(const string &filename)
+	{
+		FileStorage fs;
+		fs.open(filename, FileStorage::READ);
+		if (!fs.isOpened()) return;
+
+		if (!fs["VoxelStep"].empty()) fs["VoxelStep"] >> step;
+
+		vector<int> bounds;
+		if (!fs["VoxelVolume"].empty())
+		{
+			fs["VoxelVolume"] >> bounds;
+			if (bounds.size() == 6)
+			{
+				x_min = bounds[0]; x_max = bounds[1];
+				y_min = bounds[2]; y_max = bounds[3];
+				z_min = bounds[4]; z_max = bounds[5];
+			}
+		}
+
+		bounds.clear();
+		if (!fs["VoxelROI"].empty())
+		{
+			fs["VoxelROI"] >> bounds;
+			if (bounds.size() == 6)
+			{
+				roi = true;
+				roi_x_min = bounds[0]; roi_x_max = bounds[1];
+				roi_y_min = bounds[2]; roi_y_max = bounds[3];
+				roi_z_min = bounds[4]; roi_z_max = bounds[5];
+			}
+		}
+
+		fs.release();
+	}
+
+	/**
+	* Override the voxel space from the command line:
+	* 	--step <mm>
+	* 	--volume <x_min>,<x_max>,<y_min>,<y_max>,<z_min>,<z_max>
+	* 	--roi <x_min>,<x_max>,<y_min>,<y_max>,<z_min>,<z_max>
+	* Returns false, after telling which, if a value is missing or isn't a (list of) integer(s)
+	*/
+	bool VolumeConfig::parse(int argc, char** argv)
+	{
+		for (int a = 1; a < argc; ++a)
+		{
+			const string option = argv[a];
+			if (option != "--step" && option != "--volume" && option != "--roi") continue;
+
+			if (a + 1 >= argc)
+			{
+				cerr << option << " expects a value" << endl;
+				return false;
+			}
+			const char* value = argv[++a];
+			int b[6];
+			char end;
+			if (option == "--step")
+			{
+				if (sscanf(value, "%d%c", &step, &end) != 1)
+				{
+					cerr << "--step expects an integer, not: " << value << endl;
+					return false;
+				}
+			}
+			else if (sscanf(value, "%d,%d,%d,%d,%d,%d%c", &b[0], &b[1], &b[2], &b[3], &b[4], &b[5], &end) != 6)
+			{
+				cerr << option << " expects <x_min>,<x_max>,<y_min>,<y_max>,<z_min>,<z_max>, not: " << value << endl;
+				return false;
+			}
+			else if (option == "--volume")
+			{
+				x_min = b[0]; x_max = b[1];
+				y_min = b[2]; y_max = b[3];
+				z_min = b[4]; z_max = b[5];
+			}
+			else
+			{
+				roi = true;
+				roi_x_min = b[0]; roi_x_max = b[1];
+				roi_y_min = b[2]; roi_y_max = b[3];
+				roi_z_min = b[4]; roi_z_max = b[5];
+			}
+		}
+
+		return true;
+	}
+
+	/**
+	* Check that the voxel space holds at least one voxel, tells what's wrong if it doesn't
+	*/
+	bool VolumeConfig::validate() const
+	{
+		if (step <= 0)
+		{
+			cerr << "The voxel step must be positive, not " << step << endl;
+			return false;
+		}
+
+		const char* axes[3] = { "x", "y", "z" };
+		const int mins[3] = { x_min, y_min, z_min };
+		const int maxs[3] = { x_max, y_max, z_max };
+		const int roi_mins[3] = { roi_x_min, roi_y_min, roi_z_min };
+		const int roi_maxs[3] = { roi_x_max, roi_y_max, roi_z_max };
+		for (int a = 0; a < 3; ++a)
+		{
+			if (mins[a] >= maxs[a])
+			{
+				cerr << "The voxel volume is empty along " << axes[a] << ": [" << mins[a] << ", " << maxs[a] << ")" << endl;
+				return false;
+			}
+			if (roi && std::max(mins[a], roi_mins[a]) >= std::min(maxs[a], roi_maxs[a]))
+			{
+				cerr << "The voxel ROI doesn't intersect the volume along " << axes[a] << ": [" << roi_mins[a] << ", "
+					<< roi_maxs[a] << ") and [" << mins[a] << ", " << maxs[a] << ")" << endl;
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	/**
+	* Snap the region [roi_min, roi_max) of the volume [min, max) to the voxel lattice,
+	* returns the position of the first voxel and sets the amount of voxels
+	*/
+	static int snapRange(int min, int max, bool roi, int roi_min, int roi_max, int step, int &amount)
+	{
+		int begin = min, end = max;
+		if (roi)
+		{
+			begin = std::max(min, min + (roi_min - min) / step * step);
+			end = std::min(max, roi_max);
+		}
+		amount = std::max(0, (end - begin + step - 1) / step);
+		return begin;
+	}
+
 	/**
 	* Voxel reconstruction class
 	*/
-	Reconstructor::Reconstructor(const vector<Camera*> &cs, const string& dp) :
-		_cameras(cs), _data_path(dp)
+	Reconstructor::Reconstructor(const vector<Camera*> &cs, const string& dp, const VolumeConfig& config, ThreadPool* pool) :
+		_cameras(cs), _config(config), _pool(pool), _data_path(dp), _incremental(false), _incremental_valid(false), _octree(false)
 	{
 		for (size_t c = 0; c < _cameras.size(); ++c)
 		{
@@ -32,24 +190,35 @@ namespace nl_uu_science_gmt
 				_plane_size = _cameras[c]->getSize();
 		}
 
-		_step = 50;
-		_size = 900;
-		const size_t h_edge = _size * 4;
-		const size_t edge = 2 * h_edge;
-		_voxels_amount = (edge / _step) * (edge / _step) * (h_edge / _step);
+		// The callers validate() the configuration
+		assert(_config.step > 0);
+		_step = _config.step;
+
+		// The floor grid has 2 * 4 cells along each axis
+		_size = std::max(std::max(-_config.x_min, _config.x_max), std::max(-_config.y_min, _config.y_max)) / 4;
+
+		_grid_origin.x = snapRange(_config.x_min, _config.x_max, _config.roi, _config.roi_x_min, _config.roi_x_max, _step, _grid_x);
+		_grid_origin.y = snapRange(_config.y_min, _config.y_max, _config.roi, _config.roi_y_min, _config.roi_y_max, _step, _grid_y);
+		_grid_origin.z = snapRange(_config.z_min, _config.z_max, _config.roi, _config.roi_z_min, _config.roi_z_max, _step, _grid_z);
+		_voxels_amount = (size_t)_grid_x * _grid_y * _grid_z;
+		assert(_voxels_amount > 0);
+
+		cout << "Voxel space: " << _grid_x << "x" << _grid_y << "x" << _grid_z << " voxels of " << _step << "mm" << endl;
+
+		const OccupancyKernel::Type kernel = OccupancyKernel::detect();
+		_occupancy_kernel = OccupancyKernel::get(kernel);
+		cout << "Using the " << OccupancyKernel::getName(kernel) << " occupancy kernel" << endl;
 
 		initialize();
 	}
 
 	/**
-	* Free the memory of the pointer vectors
+	* Free the memory of the corner pointers
 	*/
 	Reconstructor::~Reconstructor()
 	{
 		for (size_t c = 0; c < _corners.size(); ++c)
 			delete _corners.at(c);
-		for (size_t v = 0; v < _voxels.size(); ++v)
-			delete _voxels.at(v);
 	}
 
 	/**
@@ -60,13 +229,12 @@ namespace nl_uu_science_gmt
 	*/
 	void Reconstructor::initialize()
 	{
-		const int h_edge = _size * 4;
-		const int xL = -h_edge;
-		const int xR = h_edge;
-		const int yL = -h_edge;
-		const int yR = h_edge;
-		const int zL = 0;
-		const int zR = h_edge;
+		const int xL = _grid_origin.x;
+		const int xR = _grid_origin.x + _grid_x * _step;
+		const int yL = _grid_origin.y;
+		const int yR = _grid_origin.y + _grid_y * _step;
+		const int zL = _grid_origin.z;
+		const int zR = _grid_origin.z + _grid_z * _step;
 
 		// Save the volume corners
 		// bottom
@@ -83,160 +251,669 @@ namespace nl_uu_science_gmt
 
 		cout << "Initializing voxels... ";
 
+		// The LUT is only valid for this voxel space, these cameras and their calibration
+		VoxelLUT::Header header = VoxelLUT::createHeader();
+		header.cameras = (uint32_t)_cameras.size();
+		header.x_min = xL;
+		header.x_max = xR;
+		header.y_min = yL;
+		header.y_max = yR;
+		header.z_min = zL;
+		header.z_max = zR;
+		header.step = _step;
+		header.width = _plane_size.width;
+		header.height = _plane_size.height;
+		header.voxels = _voxels_amount;
+		header.calibration_hash = 0;
+		for (size_t c = 0; c < _cameras.size(); ++c)
+		{
+			const uint64_t camera_hash = _cameras[c]->getCalibrationHash();
+			header.calibration_hash = General::hash(&camera_hash, sizeof(camera_hash), header.calibration_hash);
+		}
+
+		// Map the LUT from the binary file, (re)build it if it doesn't fit
+		const string lut_file = _data_path + VoxelLUT::getFilename(header);
+		if (!_lut.load(lut_file, header))
+		{
+			cout << "building LUT";
+			buildLUT(header);
+			_lut.buildPixelIndex();
+			if (!_lut.save(lut_file))
+				cerr << " (unable to write: " << lut_file << ")";
+			cout << " ";
+		}
+
 		// Acquire some memory for efficiency
-		_voxels.resize(_voxels_amount);
+		_voxels.x.resize(_voxels_amount);
+		_voxels.y.resize(_voxels_amount);
+		_voxels.z.resize(_voxels_amount);
+		_voxels.color.assign(_voxels_amount, Vec4f(0, 0, 0, 0));
 
-		ifstream inputFile(_data_path + "voxels.csv");
+		const int plane = _grid_x * _grid_y;
+		for (int p = 0; p < (int)_voxels_amount; ++p)
+		{
+			_voxels.x[p] = xL + (p % _grid_x) * _step;
+			_voxels.y[p] = yL + ((p % plane) / _grid_x) * _step;
+			_voxels.z[p] = zL + (p / plane) * _step;
+		}
 
+		// The projections stay in the (mapped) LUT
+		_voxels.camera_projection.resize(_cameras.size());
+		_voxels.valid_camera_projection.resize(_cameras.size());
+		for (size_t c = 0; c < _cameras.size(); ++c)
+		{
+			_voxels.camera_projection[c] = _lut.getProjections((int)c);
+			_voxels.valid_camera_projection[c] = _lut.getValidity((int)c);
+		}
 
-		// Load the voxels from a CSV file (if it exists)
-		if (inputFile.good()) {
-			string line;
+		cout << "done!" << endl;
+	}
 
-			int p = 0;
+	/**
+	* Project every voxel on every camera and store the result in a new LUT
+	*/
+	void Reconstructor::buildLUT(const VoxelLUT::Header &header)
+	{
+		_lut.create(header);
 
-			while (getline(inputFile, line))
-			{
-				stringstream lineStream(line);
-				string cell;
-				vector<string> result;
+		const int plane_y = (header.y_max - header.y_min) / header.step;
+		const int plane_x = (header.x_max - header.x_min) / header.step;
+		const int plane = plane_y * plane_x;
+		const int slabs = (header.z_max - header.z_min) / header.step;
 
-				while (getline(lineStream, cell, ','))
-					result.push_back(cell);
+		// Every z-slab is projected as one batch per camera, slabs are independent
+		parallelFor(_pool, 0, slabs, [&](int first, int last)
+		{
+			vector<Point3f> object_points(plane);
+			vector<Point2f> image_points(plane);
 
-				Voxel* voxel = new Voxel();
+			for (int zp = first; zp < last; ++zp)
+			{
+				const float z = (float)(header.z_min + zp * header.step);
+				for (int yp = 0; yp < plane_y; ++yp)
+				{
+					const float y = (float)(header.y_min + yp * header.step);
+					for (int xp = 0; xp < plane_x; ++xp)
+						object_points[yp * plane_x + xp] = Point3f((float)(header.x_min + xp * header.step), y, z);
+				}
 
-				// The CSV format is x,y,z,x1,y1,v1,x2,y2,v2,...,xn,yn,vn,p
-				// Where:
-				// x,y,z are the 3D coordinates of the voxel
-				// xk,yk are the 2D coordinates of the voxel's projection on camera k
-				// vk indicates if the voxels projection on camera k is valid
-				// n is the number of cameras
-				// p is the index of the voxel
+				for (size_t c = 0; c < _cameras.size(); ++c)
+				{
+					_cameras[c]->projectOnView(&object_points[0], object_points.size(), &image_points[0]);
 
-				voxel->x = stoi(result[0]);
-				voxel->y = stoi(result[1]);
-				voxel->z = stoi(result[2]);
+					// Save the linear offset of the voxel projections on camera 'c'
+					uint32_t* projections = _lut.getWritableProjections((int)c) + (size_t)zp * plane;
+					for (int v = 0; v < plane; ++v)
+					{
+						const Point point = image_points[v];
+						if (point.x >= 0 && point.x < _plane_size.width && point.y >= 0 && point.y < _plane_size.height)
+							projections[v] = (uint32_t)(point.y * _plane_size.width + point.x);
+					}
+				}
 
-				voxel->camera_projection = vector<Point>(_cameras.size());
-				voxel->valid_camera_projection = vector<int>(_cameras.size());
+				if (zp % 8 == 0) cout << "." << flush;
+			}
+		});
 
-				// i starts from 1 because the first three values have already been used above
-				for (int i = 1; i < _cameras.size() + 1; i++) {
+		// Slabs don't end on word boundaries, so the validity bits are set afterwards, one word per iteration
+		const int words = (int)((_voxels_amount + 63) / 64);
+		for (size_t c = 0; c < _cameras.size(); ++c)
+		{
+			const uint32_t* projections = _lut.getWritableProjections((int)c);
+			uint64_t* validity = _lut.getWritableValidity((int)c);
 
-					// The ith triplet on the file corresponds to the i-1th camera
-					voxel->camera_projection[i - 1] = Point(stoi(result[i * 3]), stoi(result[i * 3 + 1]));
-					voxel->valid_camera_projection[i - 1] = stoi(result[i * 3 + 2]);
+			parallelFor(_pool, 0, words, [&](int first, int last)
+			{
+				for (int w = first; w < last; ++w)
+				{
+					const size_t end = std::min(_voxels_amount, (size_t)(w + 1) * 64);
+					uint64_t bits = 0;
+					for (size_t p = (size_t)w * 64; p < end; ++p)
+						if (projections[p] != VoxelLUT::INVALID_PROJECTION) bits |= (uint64_t)1 << (p % 64);
+					validity[w] = bits;
 				}
+			}, 1024);
+		}
+	}
+
+	/**
+	* Count the amount of camera's each voxel in the space appears on,
+	* if that amount equals the amount of cameras, add that voxel to the
+	* visible_voxels vector
+	*
+	* Optimized by inverting the process (iterate over voxels instead of camera pixels for each camera)
+	* and by testing blocks of voxels with the (vectorized) occupancy kernel
+	*/
+	void Reconstructor::update()
+	{
+		_foregrounds.resize(_cameras.size());
+		for (size_t c = 0; c < _cameras.size(); ++c)
+			_foregrounds[c] = _cameras[c]->getForegroundImage();
 
-				_voxels[p] = voxel;
-				p++;
+		reconstruct(_foregrounds, _visible_voxels, _incremental, _octree);
+	}
+
+	/**
+	* Carve the voxels that are visible in all the given foreground images into 'visible' (its previous contents
+	* are recycled), incrementally and/or coarse-to-fine as given rather than as set. Only touches the carving
+	* state so it can run on another thread than the readers of getVisibleVoxels() and the setters.
+	*/
+	void Reconstructor::reconstruct(const vector<Mat> &foregrounds, vector<Voxel> &visible, bool incremental, bool octree)
+	{
+		// One gather per camera: the LUT holds linear offsets into the (continuous) foreground images,
+		// the vectorized kernels read a few bytes beyond each offset so the buffers need some padding
+		const int cameras = (int)_cameras.size();
+		assert((int)foregrounds.size() == cameras);
+		_padded_foregrounds.resize(cameras);
+		vector<const uchar*> foreground_data(cameras);
+		for (int c = 0; c < cameras; ++c)
+		{
+			const Mat &foreground = foregrounds[c];
+			assert(foreground.size() == _plane_size && foreground.type() == CV_8U);
+
+			const size_t total = foreground.total();
+			if (foreground.isContinuous() && (size_t)(foreground.datalimit - foreground.data) >= total + OccupancyKernel::PADDING)
+			{
+				foreground_data[c] = foreground.data;
 			}
+			else
+			{
+				if (_padded_foregrounds[c].empty())
+					_padded_foregrounds[c] = Mat(_plane_size.height + 1, _plane_size.width, CV_8U, Scalar::all(0));
+				Mat padded = _padded_foregrounds[c].rowRange(0, _plane_size.height);
+				foreground.copyTo(padded);
+				foreground_data[c] = padded.data;
+			}
+		}
 
+		if (incremental && !octree)
+		{
+			if (!_incremental_valid || !updateOccupancy(foreground_data))
+				seedOccupancy(foreground_data);
+			collectOccupied();
+		}
+		else
+		{
+			// The occupancy only follows the foregrounds it's updated with
+			_incremental_valid = false;
+			if (octree)
+				carveOctree(foreground_data);
+			else if (!carveFromPixels(foreground_data))
+				carve(foreground_data);
 		}
 
-		// Initialize voxels internally and save them to a CSV file
-		else {
-			ofstream outputFile;
-			outputFile.open(_data_path + "voxels.csv");
+		visible.swap(_carved_voxels);
+	}
 
-			for (int z = zL; z < zR; z += _step)
+	/**
+	* The amount of chunks to split a parallel loop over 'amount' items in
+	*/
+	int Reconstructor::getChunks(int amount) const
+	{
+		const int chunks = _pool != NULL ? (int)_pool->size() * 4 : 1;
+		return std::max(1, std::min(chunks, amount));
+	}
+
+	/**
+	* Concatenate the voxel indices of all chunks, in chunk order, into the carving output
+	*/
+	void Reconstructor::gatherChunks()
+	{
+		const int chunks = (int)_chunk_visible.size();
+		vector<size_t> offsets(chunks + 1, 0);
+		for (int k = 0; k < chunks; ++k)
+			offsets[k + 1] = offsets[k] + _chunk_visible[k].size();
+		_carved_voxels.resize(offsets[chunks]);
+
+		parallelFor(_pool, 0, chunks, [&](int first, int last)
+		{
+			for (int k = first; k < last; ++k)
+				for (size_t i = 0; i < _chunk_visible[k].size(); ++i)
+					_carved_voxels[offsets[k] + i] = Voxel(&_voxels, _chunk_visible[k][i]);
+		});
+	}
+
+	/**
+	* Test every voxel with the occupancy kernel
+	*/
+	void Reconstructor::carve(const vector<const uchar*> &foreground_data)
+	{
+		const int cameras = (int)_cameras.size();
+
+		// Every chunk tests a contiguous range of voxels into its own buffer, concatenating
+		// the buffers in chunk order gives the visible voxels in voxel order without any lock
+		const int voxels = (int)_voxels_amount;
+		const int chunks = getChunks(voxels);
+		_chunk_visible.resize(chunks);
+
+		parallelFor(_pool, 0, chunks, [&](int first, int last)
+		{
+			for (int k = first; k < last; ++k)
+			{
+				const int begin = (int)((int64)voxels * k / chunks);
+				const int end = (int)((int64)voxels * (k + 1) / chunks);
+
+				vector<int> &indices = _chunk_visible[k];
+				indices.resize(std::max(1, end - begin));
+				const size_t count = _occupancy_kernel(&_voxels.camera_projection[0], &foreground_data[0], cameras, begin, end,
+					&indices[0]);
+				indices.resize(count);
+			}
+		});
+
+		gatherChunks();
+	}
+
+	/**
+	* Foreground-pixel driven reconstruction: only the voxels behind the white pixels of the
+	* camera with the smallest silhouette are candidates. Returns false, without changing
+	* anything, if there are so many candidates that testing every voxel is cheaper.
+	*/
+	bool Reconstructor::carveFromPixels(const vector<const uchar*> &foreground_data)
+	{
+		const int cameras = (int)_cameras.size();
+		const int pixels = _plane_size.area();
+
+		// Expected amount of candidates per camera: white pixels times the mean voxels per pixel
+		int best = -1;
+		double best_candidates = (double)_voxels_amount / 8;
+		for (int c = 0; c < cameras; ++c)
+		{
+			const uchar* foreground = foreground_data[c];
+			int white = 0;
+			for (int p = 0; p < pixels; ++p)
+				white += foreground[p] == 255;
+
+			const double candidates = (double)_lut.getPixelVoxelsAmount(c) * white / pixels;
+			if (candidates < best_candidates)
 			{
-				cout << "." << flush;
+				best = c;
+				best_candidates = candidates;
+			}
+		}
+		if (best < 0) return false;
+
+		const uchar* foreground = foreground_data[best];
+		const uint32_t* start = _lut.getPixelVoxelsStart(best);
+		const uint32_t* index = _lut.getPixelVoxels(best);
+
+		const int chunks = getChunks(pixels);
+		_chunk_visible.resize(chunks);
 
-				for (int y = yL; y < yR; y += _step)
+		parallelFor(_pool, 0, chunks, [&](int first, int last)
+		{
+			for (int k = first; k < last; ++k)
+			{
+				vector<int> &indices = _chunk_visible[k];
+				indices.clear();
+
+				const int begin = (int)((int64)pixels * k / chunks);
+				const int end = (int)((int64)pixels * (k + 1) / chunks);
+				for (int p = begin; p < end; ++p)
 				{
-					for (int x = xL; x < xR; x += _step)
+					if (foreground[p] != 255) continue;
+
+					for (uint32_t e = start[p]; e < start[p + 1]; ++e)
 					{
-						Voxel* voxel = new Voxel;
-						voxel->x = x;
-						voxel->y = y;
-						voxel->z = z;
+						const uint32_t v = index[e];
+						int c = 0;
+						for (; c < cameras; ++c)
+						{
+							const uint32_t offset = _voxels.camera_projection[c][v];
+							if (offset == VoxelLUT::INVALID_PROJECTION || foreground_data[c][offset] != 255) break;
+						}
+						if (c == cameras) indices.push_back((int)v);
+					}
+				}
+			}
+		});
 
-						outputFile << x << "," << y << "," << z << ",";
+		gatherChunks();
 
-						voxel->camera_projection = vector<Point>(_cameras.size());
-						voxel->valid_camera_projection = vector<int>(_cameras.size(), 0);
+		// Pixel order isn't voxel order
+		std::sort(_carved_voxels.begin(), _carved_voxels.end(), Voxel::compareIndex);
 
-						const int zp = ((z - zL) / _step);
-						const int yp = ((y - yL) / _step);
-						const int xp = ((x - xL) / _step);
-						const int plane_y = (yR - yL) / _step;
-						const int plane_x = (xR - xL) / _step;
-						const int plane = plane_y * plane_x;
-						const int p = zp * plane + yp * plane_x + xp;  // The voxel's index
+		return true;
+	}
 
-						for (size_t c = 0; c < _cameras.size(); ++c)
-						{
-							Point point = _cameras[c]->projectOnView(Point3f((float)x, (float)y, (float)z));
+	/**
+	* Bound the LUT projections of the voxels of every octree block up to blocks of 'top_size' voxels,
+	* bottom-up: blocks of 2^3 voxels from their voxels, larger blocks from their octants
+	*/
+	void Reconstructor::buildBlockBounds(int top_size)
+	{
+		const int cameras = (int)_cameras.size();
+		const int plane = _grid_x * _grid_y;
+		const int width = _plane_size.width;
+
+		_block_bounds.clear();
+		for (int size = 2; size <= top_size; size *= 2)
+		{
+			const int level = (int)_block_bounds.size();
+			const int blocks_x = (_grid_x + size - 1) / size;
+			const int blocks_y = (_grid_y + size - 1) / size;
+			const int blocks_z = (_grid_z + size - 1) / size;
+			_block_bounds.push_back(vector<BlockBounds>((size_t)blocks_x * blocks_y * blocks_z * cameras));
+			vector<BlockBounds> &bounds = _block_bounds.back();
+
+			// The octants are the blocks of the level below, or single voxels on the first level
+			const int half = size / 2;
+			const int octants_x = (_grid_x + half - 1) / half;
+			const int octants_y = (_grid_y + half - 1) / half;
+			const int octants_z = (_grid_z + half - 1) / half;
+
+			parallelFor(_pool, 0, blocks_z, [&](int first, int last)
+			{
+				for (int bz = first; bz < last; ++bz)
+					for (int by = 0; by < blocks_y; ++by)
+						for (int bx = 0; bx < blocks_x; ++bx)
+							for (int c = 0; c < cameras; ++c)
+							{
+								int left = width, top = _plane_size.height, right = 0, bottom = 0;
+								bool complete = true;
+								for (int octant = 0; octant < 8; ++octant)
+								{
+									const int ox = 2 * bx + (octant & 1);
+									const int oy = 2 * by + ((octant >> 1) & 1);
+									const int oz = 2 * bz + ((octant >> 2) & 1);
+									if (ox >= octants_x || oy >= octants_y || oz >= octants_z) continue;
+
+									if (level == 0)
+									{
+										const uint32_t offset = _voxels.camera_projection[c][oz * plane + oy * _grid_x + ox];
+										if (offset == VoxelLUT::INVALID_PROJECTION)
+										{
+											complete = false;
+											continue;
+										}
+										const int px = (int)(offset % width);
+										const int py = (int)(offset / width);
+										left = std::min(left, px);
+										right = std::max(right, px + 1);
+										top = std::min(top, py);
+										bottom = std::max(bottom, py + 1);
+									}
+									else
+									{
+										const BlockBounds &o = _block_bounds[level - 1][(((size_t)oz * octants_y + oy) * octants_x + ox) * cameras + c];
+										complete = complete && o.complete;
+										if (o.left >= o.right) continue;
+										left = std::min(left, (int)o.left);
+										right = std::max(right, (int)o.right);
+										top = std::min(top, (int)o.top);
+										bottom = std::max(bottom, (int)o.bottom);
+									}
+								}
+
+								BlockBounds &b = bounds[(((size_t)bz * blocks_y + by) * blocks_x + bx) * cameras + c];
+								if (left >= right) left = top = right = bottom = 0;
+								b.left = (short)left;
+								b.top = (short)top;
+								b.right = (short)right;
+								b.bottom = (short)bottom;
+								b.complete = complete;
+							}
+			});
+		}
+	}
 
-							// Save the pixel coordinates 'point' of the voxel projections on camera 'c'
-							voxel->camera_projection[(int)c] = point;
+	/**
+	* Hierarchical space carving: blocks of voxels are classified with the integral images of the
+	* foregrounds as fully-in, fully-out or mixed, only the mixed blocks are subdivided.
+	*
+	* A block is bounded per camera by the rectangle around the LUT projections of all its voxels
+	* (built once, see buildBlockBounds). A black rectangle on any camera rejects the whole block,
+	* white rectangles on all cameras accept it, so the result is the same as carve()'s. Single
+	* voxels are tested like in carve().
+	*/
+	void Reconstructor::carveOctree(const vector<const uchar*> &foreground_data)
+	{
+		const int cameras = (int)_cameras.size();
 
-							if (point.x >= 0 && point.x < _plane_size.width && point.y >= 0 && point.y < _plane_size.height)
-								voxel->valid_camera_projection[(int)c] = 1;
+		_integrals.resize(cameras);
+		for (int c = 0; c < cameras; ++c)
+			integral(Mat(_plane_size, CV_8U, (void*)foreground_data[c]), _integrals[c], CV_32S);
 
-							outputFile << point.x << "," << point.y << "," << voxel->valid_camera_projection[c] << ",";
-						}
+		const int top_size = 16;  // voxels along the edge of a top level block
+		if (_block_bounds.empty()) buildBlockBounds(top_size);
+		const int blocks_x = (_grid_x + top_size - 1) / top_size;
+		const int blocks_y = (_grid_y + top_size - 1) / top_size;
+		const int blocks_z = (_grid_z + top_size - 1) / top_size;
+		const int blocks = blocks_x * blocks_y * blocks_z;
 
-						//'p' is not critical as it's unique
-						_voxels[p] = voxel;
+		// Blocks differ a lot in cost, the pool balances the chunks
+		const int chunks = std::min(blocks, getChunks(blocks) * 4);
+		_chunk_visible.resize(chunks);
 
-						outputFile << p << endl;
-					}
+		parallelFor(_pool, 0, chunks, [&](int first, int last)
+		{
+			for (int k = first; k < last; ++k)
+			{
+				_chunk_visible[k].clear();
+				for (int b = blocks * k / chunks; b < blocks * (k + 1) / chunks; ++b)
+				{
+					const int x = (b % blocks_x) * top_size;
+					const int y = ((b / blocks_x) % blocks_y) * top_size;
+					const int z = (b / (blocks_x * blocks_y)) * top_size;
+					carveBlock(x, y, z, top_size, foreground_data, _chunk_visible[k]);
 				}
 			}
+		});
 
-			outputFile.close();
+		gatherChunks();
+
+		// Block order isn't voxel order
+		std::sort(_carved_voxels.begin(), _carved_voxels.end(), Voxel::compareIndex);
+	}
+
+	/**
+	* Carve the block of size^3 voxels starting at grid position (x, y, z), clipped to the grid
+	*/
+	void Reconstructor::carveBlock(int x, int y, int z, int size, const vector<const uchar*> &foreground_data,
+		vector<int> &visible) const
+	{
+		const int x_end = std::min(x + size, _grid_x);
+		const int y_end = std::min(y + size, _grid_y);
+		const int z_end = std::min(z + size, _grid_z);
+		if (x >= x_end || y >= y_end || z >= z_end) return;
+
+		const int plane = _grid_x * _grid_y;
+		const int cameras = (int)_cameras.size();
+
+		if (size == 1)
+		{
+			const int v = z * plane + y * _grid_x + x;
+			int c = 0;
+			for (; c < cameras; ++c)
+			{
+				const uint32_t offset = _voxels.camera_projection[c][v];
+				if (offset == VoxelLUT::INVALID_PROJECTION || foreground_data[c][offset] != 255) break;
+			}
+			if (c == cameras) visible.push_back(v);
+			return;
 		}
-		cout << "done!" << endl;
 
-		inputFile.close();
+		switch (classifyBlock(x, y, z, size))
+		{
+		case BLOCK_OUT:
+			break;
+		case BLOCK_IN:
+			for (int zi = z; zi < z_end; ++zi)
+				for (int yi = y; yi < y_end; ++yi)
+					for (int xi = x; xi < x_end; ++xi)
+						visible.push_back(zi * plane + yi * _grid_x + xi);
+			break;
+		default:
+			const int half = size / 2;
+			for (int octant = 0; octant < 8; ++octant)
+				carveBlock(x + (octant & 1) * half, y + ((octant >> 1) & 1) * half, z + ((octant >> 2) & 1) * half, half,
+					foreground_data, visible);
+			break;
+		}
 	}
 
 	/**
-	* Count the amount of camera's each voxel in the space appears on,
-	* if that amount equals the amount of cameras, add that voxel to the
-	* visible_voxels vector
-	*
-	* Optimized by inverting the process (iterate over voxels instead of camera pixels for each camera)
+	* Classify the voxels of the block of size^3 voxels starting at grid position (x, y, z) with the
+	* foreground integral images and the bounds of the block's projections
 	*/
-	void Reconstructor::update()
+	Reconstructor::BlockClass Reconstructor::classifyBlock(int x, int y, int z, int size) const
+	{
+		int level = 0;
+		while ((2 << level) < size)
+			++level;
+
+		const int cameras = (int)_cameras.size();
+		const int blocks_x = (_grid_x + size - 1) / size;
+		const int blocks_y = (_grid_y + size - 1) / size;
+		const BlockBounds* bounds = &_block_bounds[level][(((size_t)(z / size) * blocks_y + y / size) * blocks_x + x / size) * cameras];
+
+		bool inside = true;
+		for (int c = 0; c < cameras; ++c)
+		{
+			// None of the voxels projects on this camera
+			const BlockBounds &b = bounds[c];
+			if (b.left >= b.right) return BLOCK_OUT;
+
+			const Mat &sum = _integrals[c];
+			const int white = sum.at<int>(b.bottom, b.right) - sum.at<int>(b.top, b.right) - sum.at<int>(b.bottom, b.left)
+				+ sum.at<int>(b.top, b.left);
+			if (white == 0) return BLOCK_OUT;
+
+			// Voxels that don't project on a camera are never visible
+			if (!b.complete || white != 255 * (b.right - b.left) * (b.bottom - b.top)) inside = false;
+		}
+
+		return inside ? BLOCK_IN : BLOCK_MIXED;
+	}
+
+	/**
+	* Count the white camera projections of every voxel and remember the foregrounds they belong to
+	*/
+	void Reconstructor::seedOccupancy(const vector<const uchar*> &foreground_data)
+	{
+		const int cameras = (int)_cameras.size();
+		const int words = (int)((_voxels_amount + 63) / 64);
+
+		_camera_hits.resize(_voxels_amount);
+		_occupied.resize(words);
+
+		parallelFor(_pool, 0, words, [&](int first, int last)
+		{
+			for (int w = first; w < last; ++w)
+			{
+				uint64_t occupied = 0;
+				const int end = std::min((int)_voxels_amount, (w + 1) * 64);
+				for (int v = w * 64; v < end; ++v)
+				{
+					uchar hits = 0;
+					for (int c = 0; c < cameras; ++c)
+					{
+						const uint32_t offset = _voxels.camera_projection[c][v];
+						if (offset != VoxelLUT::INVALID_PROJECTION && foreground_data[c][offset] == 255) ++hits;
+					}
+					_camera_hits[v] = hits;
+					if (hits == cameras) occupied |= (uint64_t)1 << (v - w * 64);
+				}
+				_occupied[w] = occupied;
+			}
+		}, 64);
+
+		_previous_foregrounds.resize(cameras);
+		for (int c = 0; c < cameras; ++c)
+		{
+			_previous_foregrounds[c].create(_plane_size, CV_8U);
+			memcpy(_previous_foregrounds[c].data, foreground_data[c], _plane_size.area());
+		}
+		_incremental_valid = true;
+	}
+
+	/**
+	* Diff the foregrounds with the previous ones and only update the voxels that project on
+	* changed pixels. Returns false, without changing anything, if that's more work than a full pass.
+	*/
+	bool Reconstructor::updateOccupancy(const vector<const uchar*> &foreground_data)
 	{
-		_visible_voxels.clear();
-		std::vector<Voxel*> visible_voxels;
+		const int cameras = (int)_cameras.size();
+		const size_t pixels = (size_t)_plane_size.area();
+		const size_t words = pixels / sizeof(uint64_t);
 
-#ifdef _OPENMP
-		omp_set_num_threads(NUM_THREADS);
-#pragma omp parallel for shared(visible_voxels)
-#endif
-		for (int v = 0; v < (int)_voxels_amount; ++v)
+		vector<vector<uint32_t> > changed(cameras);
+		size_t work = 0;
+		for (int c = 0; c < cameras; ++c)
 		{
-			int camera_counter = 0;
-			Voxel* voxel = _voxels[v];
+			const uchar* previous = _previous_foregrounds[c].data;
+			const uchar* current = foreground_data[c];
+			const uint32_t* start = _lut.getPixelVoxelsStart(c);
 
-			for (size_t c = 0; c < _cameras.size(); ++c)
+			// Skip 8 unchanged pixels at a time
+			for (size_t w = 0; w <= words; ++w)
 			{
-				if (voxel->valid_camera_projection[c])
+				const size_t begin = w * sizeof(uint64_t);
+				const size_t end = std::min(pixels, begin + sizeof(uint64_t));
+				if (w < words)
 				{
-					const Point point = voxel->camera_projection[c];
+					uint64_t a, b;
+					memcpy(&a, previous + begin, sizeof(uint64_t));
+					memcpy(&b, current + begin, sizeof(uint64_t));
+					if (a == b) continue;
+				}
 
-					//If there's a white pixel on the foreground image at the projection point, add the camera
-					if (_cameras[c]->getForegroundImage().at<uchar>(point) == 255) ++camera_counter;
+				for (size_t p = begin; p < end; ++p)
+				{
+					if ((previous[p] == 255) != (current[p] == 255))
+					{
+						changed[c].push_back((uint32_t)p);
+						work += start[p + 1] - start[p];
+					}
 				}
 			}
+		}
+
+		if (work > _voxels_amount / 2) return false;
+
+		for (int c = 0; c < cameras; ++c)
+		{
+			const uchar* current = foreground_data[c];
+			const uint32_t* start = _lut.getPixelVoxelsStart(c);
+			const uint32_t* index = _lut.getPixelVoxels(c);
 
-			// If the voxel is present on all cameras
-			if (camera_counter == _cameras.size())
+			for (size_t i = 0; i < changed[c].size(); ++i)
 			{
-#ifdef _OPENMP
-#pragma omp critical //push_back is critical
-#endif
-				visible_voxels.push_back(voxel);
+				const uint32_t p = changed[c][i];
+				const bool white = current[p] == 255;
+				for (uint32_t e = start[p]; e < start[p + 1]; ++e)
+				{
+					const uint32_t v = index[e];
+					_camera_hits[v] = white ? _camera_hits[v] + 1 : _camera_hits[v] - 1;
+
+					const uint64_t bit = (uint64_t)1 << (v & 63);
+					if (_camera_hits[v] == cameras)
+						_occupied[v >> 6] |= bit;
+					else
+						_occupied[v >> 6] &= ~bit;
+				}
 			}
+
+			memcpy(_previous_foregrounds[c].data, current, pixels);
 		}
 
-		_visible_voxels.insert(_visible_voxels.end(), visible_voxels.begin(), visible_voxels.end());
+		return true;
+	}
+
+	/**
+	* Turn the occupancy bitset into the list of visible voxels (in voxel order)
+	*/
+	void Reconstructor::collectOccupied()
+	{
+		_carved_voxels.clear();
+		for (size_t w = 0; w < _occupied.size(); ++w)
+		{
+			const uint64_t occupied = _occupied[w];
+			if (occupied == 0) continue;
+
+			for (int b = 0; b < 64; ++b)
+				if ((occupied >> b) & 1) _carved_voxels.push_back(Voxel(&_voxels, (int)(w * 64 + b)));
+		}
 	}
 
 } /* namespace nl_uu_science_gmt */
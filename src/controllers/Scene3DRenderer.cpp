@@ -8,8 +8,12 @@
 #include <opencv2/opencv.hpp>
 
 #include "Scene3DRenderer.h"
+#include "ForegroundKernel.h"
+#include "Morphology.h"
+#include "OccupancyKernel.h"
 
 #include <stddef.h>
+#include <algorithm>
 #include <cassert>
 #include <string>
 
@@ -20,9 +24,9 @@ namespace nl_uu_science_gmt
 {
 
 /**
- * Scene properties class (mostly called by Glut)
+ * Scene properties class (mostly called by Glut), 'windowed' puts the frame and threshold trackbars on the video window
  */
-Scene3DRenderer::Scene3DRenderer(Reconstructor &r, const vector<Camera*> &cs) :
+Scene3DRenderer::Scene3DRenderer(Reconstructor &r, const vector<Camera*> &cs, bool windowed) :
 		_reconstructor(r), _cameras(cs), _num(4), _sphere_radius(1850)
 {
 	_width = 640;
@@ -71,12 +75,22 @@ Scene3DRenderer::Scene3DRenderer(Reconstructor &r, const vector<Camera*> &cs) :
 	_e_d_selection = E_D;
 	_e_d_number = E_D_NUM;
 
-	createTrackbar("Frame", VIDEO_WINDOW, &_current_frame, _number_of_frames - 2);
-	createTrackbar("H", VIDEO_WINDOW, &_h_threshold, 255);
-	createTrackbar("S", VIDEO_WINDOW, &_s_threshold, 255);
-	createTrackbar("V", VIDEO_WINDOW, &_v_threshold, 255);
-	createTrackbar("E/D", VIDEO_WINDOW, &_e_d_selection, 1);
-	createTrackbar("# E/D", VIDEO_WINDOW, &_e_d_number, 15);
+	_adaptive = false;
+	_foreground_kernel.setPool(r.getPool());
+	_morphology.setPool(r.getPool());
+	_foreground_frames.assign(_cameras.size(), -1);
+	_differences.resize(_cameras.size());
+	_difference_frames.assign(_cameras.size(), -1);
+
+	if (windowed)
+	{
+		createTrackbar("Frame", VIDEO_WINDOW, &_current_frame, _number_of_frames - 2);
+		createTrackbar("H", VIDEO_WINDOW, &_h_threshold, 255);
+		createTrackbar("S", VIDEO_WINDOW, &_s_threshold, 255);
+		createTrackbar("V", VIDEO_WINDOW, &_v_threshold, 255);
+		createTrackbar("E/D", VIDEO_WINDOW, &_e_d_selection, 1);
+		createTrackbar("# E/D", VIDEO_WINDOW, &_e_d_number, 15);
+	}
 
 	createFloorGrid();
 	setTopView();
@@ -97,17 +111,24 @@ Scene3DRenderer::~Scene3DRenderer()
  */
 bool Scene3DRenderer::processFrame()
 {
+	// Every camera decodes on its own thread
 	for (size_t c = 0; c < _cameras.size(); ++c)
 	{
+		assert(_cameras[c] != nullptr);
 		if (_current_frame == _previous_frame + 1)
 		{
-			_cameras[c]->advanceVideoFrame();
+			_cameras[c]->requestVideoFrame();
 		}
 		else if (_current_frame != _previous_frame)
 		{
-			_cameras[c]->getVideoFrame(_current_frame);
+			_cameras[c]->requestVideoFrame(_current_frame);
 		}
-		assert(_cameras[c] != nullptr);
+	}
+
+	// Frame barrier: the reconstruction gets the frames of all cameras at once
+	for (size_t c = 0; c < _cameras.size(); ++c)
+	{
+		_cameras[c]->waitVideoFrame();
 		processForeground(_cameras[c]);
 	}
 	return true;
@@ -119,46 +140,92 @@ bool Scene3DRenderer::processFrame()
  */
 void Scene3DRenderer::processForeground(Camera* camera)
 {
-	assert(!camera->getFrame().empty());
-	Mat hsv_image;
-	cvtColor(camera->getFrame(), hsv_image, CV_BGR2HSV);  // from BGR to HSV color space
-
-	vector<Mat> channels;
-	split(hsv_image, channels);  // Split the HSV-channels for further analysis
-
-	// Background subtraction H
-	Mat tmp, foreground, background;
-	absdiff(channels[0], camera->getBgHsvChannels().at(0), tmp);
-	threshold(tmp, foreground, _h_threshold, 255, CV_THRESH_BINARY);
-
-	// Background subtraction S
-	absdiff(channels[1], camera->getBgHsvChannels().at(1), tmp);
-	threshold(tmp, background, _s_threshold, 255, CV_THRESH_BINARY);
-	bitwise_and(foreground, background, foreground);
-
-	// Background subtraction V
-	absdiff(channels[2], camera->getBgHsvChannels().at(2), tmp);
-	threshold(tmp, background, _v_threshold, 255, CV_THRESH_BINARY);
-	bitwise_or(foreground, background, foreground);
-
-	Mat element = getStructuringElement(MORPH_ELLIPSE, Size(4, 4));
-
-	if (_e_d_selection == 0){
-		for (int i = 0; i < _e_d_number; i++){
-			erode(foreground, foreground, element);
-			dilate(foreground, foreground, element);
-		}
+	const size_t c = std::find(_cameras.begin(), _cameras.end(), camera) - _cameras.begin();
+	assert(c < _cameras.size());
+
+	// Reuse the camera's foreground buffer
+	Mat foreground = camera->getForegroundImage();
+	processForeground(c, camera->getFrame(), camera->getFrameNumber(), foreground, getSettings());
+	camera->setForegroundImage(foreground);
+}
+
+/**
+ * Separate the background from the foreground of frame number 'frame_number' of camera 'c' into 'foreground',
+ * whose buffer is reused if it fits, with the given thresholds and morphology
+ */
+void Scene3DRenderer::processForeground(size_t c, const Mat &frame, int frame_number, Mat &foreground,
+		const FrameSettings &settings)
+{
+	assert(!frame.empty() && c < _cameras.size());
+	Camera* camera = _cameras[c];
+
+	// The foreground buffer has a spare row so the reconstructor can read past the last pixel
+	if (foreground.size() != frame.size() || (size_t) (foreground.datalimit - foreground.data) < foreground.total() + OccupancyKernel::PADDING)
+		foreground = Mat(frame.rows + 1, frame.cols, CV_8U, Scalar::all(0)).rowRange(0, frame.rows);
+
+	_foreground_kernel.setThresholds(settings.h_threshold, settings.s_threshold, settings.v_threshold);
+
+	if (settings.adaptive)
+	{
+		// The model only learns from a frame once
+		const bool learn = _foreground_frames[c] != frame_number;
+		_foreground_kernel.subtractAdaptive(frame, camera->getBgModel(), foreground, learn);
+		_foreground_frames[c] = frame_number;
 	}
-	else{
-		for (int i = 0; i < _e_d_number; i++){
-			dilate(foreground, foreground, element);
-			erode(foreground, foreground, element);
+	else if (_foreground_frames[c] == frame_number)
+	{
+		// Same frame with other thresholds (eg. sliders moved while paused), keep the differences and threshold those
+		if (_difference_frames[c] != frame_number)
+		{
+			ForegroundKernel::difference(frame, camera->getBgHsv(), _differences[c], _reconstructor.getPool());
+			_difference_frames[c] = frame_number;
 		}
+		_foreground_kernel.threshold(_differences[c], foreground);
+	}
+	else
+	{
+		// Background subtraction HSV in one pass
+		_foreground_kernel.subtract(frame, camera->getBgHsv(), foreground);
+		_foreground_frames[c] = frame_number;
 	}
 
-	// Improve the foreground image
+	// Erode/dilate rounds with the 4x4 ellipse, as cv::erode and cv::dilate would
+	if (settings.e_d_selection == 0)
+		_morphology.erodeDilate(foreground, settings.e_d_number);
+	else
+		_morphology.dilateErode(foreground, settings.e_d_number);
+}
 
-	camera->setForegroundImage(foreground);
+/**
+ * The current slider and key settings, only to be read on the thread that changes them
+ */
+FrameSettings Scene3DRenderer::getSettings() const
+{
+	FrameSettings settings;
+	settings.h_threshold = _h_threshold;
+	settings.s_threshold = _s_threshold;
+	settings.v_threshold = _v_threshold;
+	settings.e_d_selection = _e_d_selection;
+	settings.e_d_number = _e_d_number;
+	settings.adaptive = _adaptive;
+	settings.incremental = _reconstructor.isIncremental();
+	settings.octree = _reconstructor.isOctree();
+	return settings;
+}
+
+/**
+ * Set the sliders and keys, on the thread that reads them
+ */
+void Scene3DRenderer::setSettings(const FrameSettings &settings)
+{
+	_h_threshold = settings.h_threshold;
+	_s_threshold = settings.s_threshold;
+	_v_threshold = settings.v_threshold;
+	_e_d_selection = settings.e_d_selection;
+	_e_d_number = settings.e_d_number;
+	_adaptive = settings.adaptive;
+	_reconstructor.setIncremental(settings.incremental);
+	_reconstructor.setOctree(settings.octree);
 }
 
 /**
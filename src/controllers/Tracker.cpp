@@ -18,7 +18,7 @@ namespace nl_uu_science_gmt
 {
 
 	Tracker::Tracker(const vector<Camera*> &cs, const string& dp, Scene3DRenderer &s3d, int cn) :
-		_cameras(cs), _data_path(dp), _scene3d(s3d), _active(false), _clusters_number(cn)
+		_cameras(cs), _data_path(dp), _scene3d(s3d), _active(false), _interactive(true), _clusters_number(cn)
 	{
 		_unrefined_centers.resize(_clusters_number);
 		_refined_centers.resize(_clusters_number);
@@ -29,15 +29,24 @@ namespace nl_uu_science_gmt
 	}
 
 	void Tracker::update() {
-		vector<Reconstructor::Voxel*> voxels = _scene3d.getReconstructor().getVisibleVoxels();
-		if (voxels.size() > _scene3d.getReconstructor().getVoxels().size() / 4) {
-			if (!General::popup("Warning", "HSV unbalanced, Proceed?")) {
+		const vector<Reconstructor::Voxel>& voxels = _scene3d.getReconstructor().getVisibleVoxels();
+		if (voxels.size() > _scene3d.getReconstructor().getVoxelsAmount() / 4) {
+			if (!_interactive) {
+				cerr << "Warning: HSV unbalanced" << endl;
+			}
+			else if (!General::popup("Warning", "HSV unbalanced, Proceed?")) {
 				_active = false;
 				return;
 			}
 		}
 
 		if (_color_models.size() == 0) {
+			if (!_interactive) {
+				// The frame for the color model is picked by hand
+				cerr << "No color model in " << _data_path << CM_FILENAME << ", tracking off" << endl;
+				_active = false;
+				return;
+			}
 			createColorModel();
 			return;
 		}
@@ -90,9 +99,9 @@ namespace nl_uu_science_gmt
 
 				// update label according to the most suitable color model
 				va->label = m;
-				points4Relabelling[m].push_back(Point2f(va->voxel->x, va->voxel->y));
-				//centers4Clustering.push_back(Point2f(va->voxel->x, va->voxel->y));
-				va->voxel->color = _color_models[m]->color;
+				points4Relabelling[m].push_back(Point2f(va->voxel.getX(), va->voxel.getY()));
+				//centers4Clustering.push_back(Point2f(va->voxel.getX(), va->voxel.getY()));
+				va->voxel.setColor(_color_models[m]->color);
 			}
 		}
 
@@ -140,7 +149,7 @@ namespace nl_uu_science_gmt
 			float closestCenterDst = FLT_MAX;
 			int c;
 			for (int j = 0; j < _clusters_number; j++) {
-				Point voxel(voxels[i]->x, voxels[i]->y);
+				Point voxel(voxels[i].getX(), voxels[i].getY());
 				float currentCenterDst = General::pointDistance(voxel, _unrefined_centers[j].back());
 				if (currentCenterDst < closestCenterDst) {
 					c = j;
@@ -148,8 +157,8 @@ namespace nl_uu_science_gmt
 				}
 			}
 			if (closestCenterDst < 1000) {
-				voxels[i]->color = _color_models[c]->color;
-				relabelledPoints[c].push_back(Point2f(voxels[i]->x, voxels[i]->y));
+				voxels[i].setColor(_color_models[c]->color);
+				relabelledPoints[c].push_back(Point2f(voxels[i].getX(), voxels[i].getY()));
 				count[c]++;
 			}
 			else {
@@ -158,8 +167,8 @@ namespace nl_uu_science_gmt
 					if (count[j] < count[lessPop])
 						lessPop = j;
 				}
-				voxels[i]->color = _color_models[lessPop]->color;
-				relabelledPoints[lessPop].push_back(Point2f(voxels[i]->x, voxels[i]->y));
+				voxels[i].setColor(_color_models[lessPop]->color);
+				relabelledPoints[lessPop].push_back(Point2f(voxels[i].getX(), voxels[i].getY()));
 				count[lessPop]++;
 			}
 		}
@@ -195,7 +204,7 @@ namespace nl_uu_science_gmt
 			float closestCenterDst = FLT_MAX;
 			int c;
 			for (int j = 0; j < _clusters_number; j++) {
-				Point voxel(voxels[i]->x, voxels[i]->y);
+				Point voxel(voxels[i].getX(), voxels[i].getY());
 				float currentCenterDst = General::pointDistance(voxel, tmpCenters[j]);
 				if (currentCenterDst < closestCenterDst) {
 					c = j;
@@ -203,11 +212,11 @@ namespace nl_uu_science_gmt
 				}
 			}
 			if (closestCenterDst > 700) {
-				voxels[i]->color = Scalar(0.5f, 0.5f, 0.5f, 0.5f);
+				voxels[i].setColor(Scalar(0.5f, 0.5f, 0.5f, 0.5f));
 				continue;
 			}
-			voxels[i]->color = _color_models[c]->color;
-			rerelabelledPoints[c].push_back(Point2f(voxels[i]->x, voxels[i]->y));
+			voxels[i].setColor(_color_models[c]->color);
+			rerelabelledPoints[c].push_back(Point2f(voxels[i].getX(), voxels[i].getY()));
 		}
 
 		// Compute final centers
@@ -259,12 +268,12 @@ namespace nl_uu_science_gmt
 
 		rec.update();
 
-		vector<Reconstructor::Voxel*> voxels = rec.getVisibleVoxels();
+		const vector<Reconstructor::Voxel>& voxels = rec.getVisibleVoxels();
 
 		Mat labels, coordinates;
 
 		for (int i = 0; i < voxels.size(); i++)
-			coordinates.push_back(Point2f(voxels[i]->x, voxels[i]->y));
+			coordinates.push_back(Point2f(voxels[i].getX(), voxels[i].getY()));
 
 		TermCriteria criteria;
 		criteria.maxCount = 10;
@@ -399,7 +408,7 @@ namespace nl_uu_science_gmt
 	/**
 	* project voxels to views paying attention to occlusions
 	*/
-	void Tracker::projectVoxels(vector<Reconstructor::Voxel*> voxels, vector<map<float,VoxelAttributes*>>& outputVector, const Mat labels, const int heightLimit) {
+	void Tracker::projectVoxels(vector<Reconstructor::Voxel> voxels, vector<map<float,VoxelAttributes*>>& outputVector, const Mat labels, const int heightLimit) {
 
 		// look for non-occluded voxels for each view
 		for (int i = 0; i < _cameras.size(); i++){
@@ -408,18 +417,27 @@ namespace nl_uu_science_gmt
 
 			Point3f camLocation = _cameras[i]->getCameraLocation();
 
+			// project all remaining voxels on this view at once, 'projections' follows the reordering of 'voxels'
+			_points.resize(voxels.size());
+			_projections.resize(voxels.size());
+			for (int j = 0; j < voxels.size(); j++)
+				_points[j] = Point3f((float)voxels[j].getX(), (float)voxels[j].getY(), (float)voxels[j].getZ());
+			if (!voxels.empty())
+				_cameras[i]->projectOnView(&_points[0], voxels.size(), &_projections[0]);
+
 			// for each voxel
 			for (int j = 0; j < voxels.size(); j++){
 
-				if (voxels[j]->z < heightLimit) {
+				if (voxels[j].getZ() < heightLimit) {
 					voxels.erase(voxels.begin() + j);
+					_projections.erase(_projections.begin() + j);
 					j--;
 					continue;
 				}
 				// determine the projection
 				Point2i projection;
 
-				projection = _cameras[i]->projectOnView(Point3f(voxels[j]->x, voxels[j]->y, voxels[j]->z));
+				projection = _projections[j];
 				int x = projection.x;
 				int y = projection.y;
 				float key = (x + y)*(x + y + 1) / 2 + y;
@@ -434,28 +452,32 @@ namespace nl_uu_science_gmt
 					// if it hasn't, add projection and projected voxel to the respective vectors
 					visibleVoxels[key] = va;
 					voxels.erase(voxels.begin() + j);
+					_projections.erase(_projections.begin() + j);
 					j--;
 				}
 				else {
 					float distOld, distNew;
 					VoxelAttributes* va = visibleVoxels[key];
 					// distance from old voxel to camera
-					distOld = sqrt(pow(va->voxel->x - camLocation.x, 2) +
-						pow(va->voxel->y - camLocation.y, 2) +
-						pow(va->voxel->z - camLocation.z, 2));
+					distOld = sqrt(pow(va->voxel.getX() - camLocation.x, 2) +
+						pow(va->voxel.getY() - camLocation.y, 2) +
+						pow(va->voxel.getZ() - camLocation.z, 2));
 					// distance from new voxel to camera
 					distNew =
-						sqrt(pow(voxels[j]->x - camLocation.x, 2) +
-						pow(voxels[j]->y - camLocation.y, 2) +
-						pow(voxels[j]->z - camLocation.z, 2));
+						sqrt(pow(voxels[j].getX() - camLocation.x, 2) +
+						pow(voxels[j].getY() - camLocation.y, 2) +
+						pow(voxels[j].getZ() - camLocation.z, 2));
 					// if it has, and the new voxel is closer to the camera than the old one, substitute
 					if (distOld > distNew) {
-						Reconstructor::Voxel* tmp = va->voxel;
+						Reconstructor::Voxel tmp = va->voxel;
 						va->voxel = voxels[j];
 						if (!labels.empty())
 							va->label = labels.at<int>(j);
 						voxels.erase(voxels.begin() + j);
 						voxels.push_back(tmp);
+						// same key, so the swapped voxel projects on the same pixel
+						_projections.push_back(_projections[j]);
+						_projections.erase(_projections.begin() + j);
 					}
 				}
 
@@ -505,14 +527,21 @@ namespace nl_uu_science_gmt
 	void Tracker::saveTrack() {
 		
 		ofstream outputFile;
-		outputFile.open(_data_path + "track.txt", ios::app);
+		outputFile.open(_data_path + General::TrackFile, ios::app);
 
+		writeTrack(outputFile);
+		outputFile.close();
+	}
+
+	/**
+	* Writes the current cluster centers as one line
+	*/
+	void Tracker::writeTrack(ostream& output) const {
 		for (int i = 0; i < _color_models.size(); i++) {
-			outputFile << _refined_centers[i].back() << "\t";
+			output << _refined_centers[i].back() << "\t";
 		}
 
-		outputFile << endl;
-		outputFile.close();
+		output << endl;
 	}
 
 } /* namespace nl_uu_science_gmt */
@@ -0,0 +1,259 @@
+/*
+ * VoxelLUT.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: Ulisse Bordignon, Nicola Chinellato
+ */
+
+#include "General.h"
+#include "VoxelLUT.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+using namespace std;
+
+namespace nl_uu_science_gmt
+{
+
+static const char LUT_MAGIC[8] = { 'V', 'O', 'X', 'E', 'L', 'L', 'U', 'T' };
+static const size_t LUT_ALIGN = 64;
+
+/**
+ * Round up to the section alignment
+ */
+static inline size_t align(size_t offset)
+{
+	return (offset + LUT_ALIGN - 1) & ~(LUT_ALIGN - 1);
+}
+
+VoxelLUT::VoxelLUT() :
+		_header(createHeader()), _data(NULL), _size(0)
+{
+}
+
+VoxelLUT::~VoxelLUT()
+{
+}
+
+/**
+ * Return an empty header for the current LUT version
+ */
+VoxelLUT::Header VoxelLUT::createHeader()
+{
+	Header header;
+	memset(&header, 0, sizeof(Header));
+	memcpy(header.magic, LUT_MAGIC, sizeof(LUT_MAGIC));
+	header.version = VERSION;
+	return header;
+}
+
+/**
+ * LUT file name for a header: every volume/resolution/camera setup gets its own file,
+ * a calibration change overwrites the file of its setup
+ */
+string VoxelLUT::getFilename(const Header &header)
+{
+	Header key = header;
+	key.calibration_hash = 0;
+
+	const uint64_t h = General::hash(&key, sizeof(Header));
+	stringstream filename;
+	filename << "voxels_" << header.step << "mm_" << hex << setw(16) << setfill('0') << h << ".lut";
+	return filename.str();
+}
+
+size_t VoxelLUT::getPixelsAmount() const
+{
+	return (size_t) _header.width * _header.height;
+}
+
+/**
+ * The table with the amount of pixel index entries per camera follows the header
+ */
+size_t VoxelLUT::getPixelIndexOffset() const
+{
+	return align(sizeof(Header));
+}
+
+size_t VoxelLUT::getProjectionsOffset(int camera) const
+{
+	const size_t projections = align((size_t) _header.voxels * sizeof(uint32_t));
+	const size_t validity = align(((size_t) _header.voxels + 63) / 64 * sizeof(uint64_t));
+	return getPixelIndexOffset() + align(_header.cameras * sizeof(uint64_t)) + camera * (projections + validity);
+}
+
+size_t VoxelLUT::getValidityOffset(int camera) const
+{
+	return getProjectionsOffset(camera) + align((size_t) _header.voxels * sizeof(uint32_t));
+}
+
+/**
+ * Place the pixel indices after the voxel to pixel tables, the last offset is the total LUT size
+ */
+void VoxelLUT::computePixelIndexOffsets()
+{
+	_pixel_index_offsets.resize(_header.cameras + 1);
+	_pixel_index_offsets[0] = getProjectionsOffset(_header.cameras);
+	for (uint32_t c = 0; c < _header.cameras; ++c)
+	{
+		const size_t entries = getPixelsAmount() + 1 + (size_t) getPixelVoxelsAmount(c);
+		_pixel_index_offsets[c + 1] = _pixel_index_offsets[c] + align(entries * sizeof(uint32_t));
+	}
+}
+
+/**
+ * Map the LUT file into memory
+ *
+ * Returns false if the file is missing, truncated or if its header doesn't match
+ * the expected header (other version, volume or camera calibration)
+ */
+bool VoxelLUT::load(const string &filename, const Header &expected)
+{
+	release();
+
+	if (!_file.open(filename)) return false;
+
+	if (_file.getSize() < sizeof(Header) || memcmp(_file.getData(), &expected, sizeof(Header)) != 0)
+	{
+		const Header* found = (const Header*) _file.getData();
+		if (_file.getSize() >= sizeof(Header) && found->calibration_hash != expected.calibration_hash)
+			cout << "camera calibration changed, ";
+		_file.close();
+		return false;
+	}
+
+	_header = expected;
+	if (_file.getSize() < getProjectionsOffset(_header.cameras))
+	{
+		_file.close();
+		return false;
+	}
+
+	_data = _file.getData();
+	computePixelIndexOffsets();
+	if (_file.getSize() != _pixel_index_offsets.back())
+	{
+		release();
+		return false;
+	}
+
+	_size = _file.getSize();
+
+	return true;
+}
+
+/**
+ * Allocate an empty (all projections invalid) LUT in memory for the given header,
+ * call buildPixelIndex() once the projections are filled in
+ */
+void VoxelLUT::create(const Header &header)
+{
+	release();
+
+	_header = header;
+	_size = getProjectionsOffset(_header.cameras);
+	_buffer.assign(_size / sizeof(uint64_t), 0);
+	_data = (const char*) &_buffer[0];
+	memcpy(&_buffer[0], &_header, sizeof(Header));
+
+	for (uint32_t c = 0; c < _header.cameras; ++c)
+	{
+		uint32_t* projections = getWritableProjections(c);
+		std::fill(projections, projections + _header.voxels, INVALID_PROJECTION);
+	}
+
+	computePixelIndexOffsets();
+}
+
+/**
+ * Invert the voxel to pixel tables into the pixel to voxels (CSR) indices
+ */
+void VoxelLUT::buildPixelIndex()
+{
+	if (_buffer.empty()) return;
+
+	const size_t pixels = getPixelsAmount();
+
+	// Count the voxels per pixel
+	vector<vector<uint32_t> > starts(_header.cameras, vector<uint32_t>(pixels + 1, 0));
+	uint64_t* amounts = (uint64_t*) ((char*) &_buffer[0] + getPixelIndexOffset());
+	for (uint32_t c = 0; c < _header.cameras; ++c)
+	{
+		const uint32_t* projections = getProjections(c);
+		vector<uint32_t> &start = starts[c];
+		for (size_t v = 0; v < _header.voxels; ++v)
+			if (projections[v] != INVALID_PROJECTION) ++start[projections[v] + 1];
+		for (size_t p = 0; p < pixels; ++p)
+			start[p + 1] += start[p];
+		amounts[c] = start[pixels];
+	}
+
+	computePixelIndexOffsets();
+	_size = _pixel_index_offsets.back();
+	_buffer.resize(_size / sizeof(uint64_t), 0);
+	_data = (const char*) &_buffer[0];
+
+	// Filling in voxel order keeps the voxel list of every pixel sorted
+	for (uint32_t c = 0; c < _header.cameras; ++c)
+	{
+		const uint32_t* projections = getProjections(c);
+		uint32_t* start = (uint32_t*) ((char*) &_buffer[0] + _pixel_index_offsets[c]);
+		uint32_t* voxels = start + pixels + 1;
+
+		memcpy(start, &starts[c][0], (pixels + 1) * sizeof(uint32_t));
+		vector<uint32_t> &cursor = starts[c];
+		for (size_t v = 0; v < _header.voxels; ++v)
+			if (projections[v] != INVALID_PROJECTION) voxels[cursor[projections[v]]++] = (uint32_t) v;
+	}
+}
+
+/**
+ * Write the LUT to a binary file in one go
+ */
+bool VoxelLUT::save(const string &filename) const
+{
+	if (_data == NULL) return false;
+
+	ofstream output_file(filename.c_str(), ios::out | ios::binary | ios::trunc);
+	if (!output_file.is_open()) return false;
+
+	output_file.write(_data, _size);
+	output_file.close();
+
+	return !output_file.fail();
+}
+
+/**
+ * Unmap or free the LUT
+ */
+void VoxelLUT::release()
+{
+	_file.close();
+	vector<uint64_t>().swap(_buffer);
+	_pixel_index_offsets.clear();
+	_data = NULL;
+	_size = 0;
+}
+
+/**
+ * Writable projections, only for LUTs that are created in memory
+ */
+uint32_t* VoxelLUT::getWritableProjections(int camera)
+{
+	return _buffer.empty() ? NULL : (uint32_t*) (_data + getProjectionsOffset(camera));
+}
+
+/**
+ * Writable validity bitset, only for LUTs that are created in memory
+ */
+uint64_t* VoxelLUT::getWritableValidity(int camera)
+{
+	return _buffer.empty() ? NULL : (uint64_t*) (_data + getValidityOffset(camera));
+}
+
+} /* namespace nl_uu_science_gmt */
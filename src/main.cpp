@@ -1,17 +1,140 @@
 #include "General.h"
 
+#include "ProcessingContext.h"
+#include "ProcessingOptions.h"
+#include "ThreadPool.h"
 #include "VoxelReconstruction.h"
 
+#include <stddef.h>
+#include <cstdio>
 #include <cstdlib>
+#include <iostream>
+#include <sstream>
 #include <string>
+#include <thread>
+#include <vector>
 
 using namespace nl_uu_science_gmt;
 
 int main(int argc, char** argv)
 {
-	VoxelReconstruction::showKeys();
-	VoxelReconstruction vr("data" + std::string(PATH_SEP), 4);
-	vr.run(argc, argv);
+	// The camera rigs (data paths) to process, 'data/' if none is given
+	std::vector<std::string> data_paths;
+	std::string output_path;
+	int cameras = 4;
+	size_t threads = 0;
+	std::vector<int> cpus;
+	int cv_threads = 0;
+	bool headless = false;
+	for (int a = 1; a < argc; ++a)
+	{
+		const std::string option = argv[a];
+		if (option == "--headless")
+		{
+			headless = true;
+			continue;
+		}
+		if (option != "--data" && option != "--output" && option != "--cameras" && option != "--threads"
+			&& option != "--affinity" && option != "--cv-threads") continue;
 
-	return EXIT_SUCCESS;
-}
\ No newline at end of file
+		if (a + 1 >= argc)
+		{
+			std::cerr << option << " expects a value" << std::endl;
+			return EXIT_FAILURE;
+		}
+		const std::string value = argv[++a];
+		int amount;
+		char end;
+		if (option == "--data" || option == "--output")
+		{
+			if (value.empty())
+			{
+				std::cerr << option << " expects a path" << std::endl;
+				return EXIT_FAILURE;
+			}
+			if (option == "--data")
+				data_paths.push_back(value);
+			else
+				output_path = value;
+		}
+		else if (option == "--cameras")
+		{
+			if (sscanf(value.c_str(), "%d%c", &amount, &end) != 1 || amount < 1)
+			{
+				std::cerr << "--cameras expects a positive amount of cameras, not: " << value << std::endl;
+				return EXIT_FAILURE;
+			}
+			cameras = amount;
+		}
+		else if (option == "--threads" || option == "--cv-threads")
+		{
+			if (sscanf(value.c_str(), "%d%c", &amount, &end) != 1 || amount < 0)
+			{
+				std::cerr << option << " expects a non-negative amount of threads, not: " << value << std::endl;
+				return EXIT_FAILURE;
+			}
+			if (option == "--threads")
+				threads = (size_t) amount;
+			else
+				cv_threads = amount;
+		}
+		else if (!ThreadPool::parseCpus(value, cpus))
+		{
+			return EXIT_FAILURE;
+		}
+	}
+	if (data_paths.empty()) data_paths.push_back("data");
+	for (size_t d = 0; d < data_paths.size(); ++d)
+		if (data_paths[d][data_paths[d].size() - 1] != PATH_SEP[0]) data_paths[d] += PATH_SEP;
+	if (!output_path.empty() && output_path[output_path.size() - 1] != PATH_SEP[0]) output_path += PATH_SEP;
+
+	// The processing options are the same for every rig
+	ProcessingOptions options;
+	if (!options.parse(argc, argv)) return EXIT_FAILURE;
+
+	// One pool for all parallel work, OpenCV's own loops would compete with it for the same cores
+	ThreadPool pool(threads, cpus);
+	ThreadPool::setOpenCVThreads(cv_threads);
+
+	if (!headless)
+	{
+		// Interactive: one rig, in windows
+		VoxelReconstruction::showKeys();
+		VoxelReconstruction vr(data_paths.front(), cameras);
+
+		return vr.run(argc, argv, options, &pool) ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+	// Batch processing without any window (eg. on servers without display), all rigs side by side: every
+	// rig plays on a thread of its own, the per frame loops of all rigs share the pool
+	std::vector<ProcessingContext*> contexts;
+	std::vector<std::thread> rigs;
+	for (size_t d = 0; d < data_paths.size(); ++d)
+	{
+		ProcessingContext* context = new ProcessingContext(data_paths[d], cameras);
+		if (!output_path.empty())
+		{
+			// Several rigs share the output path, their files get the rig number as prefix
+			std::stringstream prefix;
+			if (data_paths.size() > 1) prefix << "rig" << (d + 1) << "_";
+			context->setOutputPath(output_path + prefix.str());
+		}
+		contexts.push_back(context);
+
+		rigs.push_back(std::thread([context, &options, &pool, argc, argv]
+		{
+			if (context->initialize(argc, argv, options, &pool)) context->run();
+		}));
+	}
+	for (size_t r = 0; r < rigs.size(); ++r)
+		rigs[r].join();
+
+	bool done = true;
+	for (size_t c = 0; c < contexts.size(); ++c)
+	{
+		done = contexts[c]->finish() && done;
+		delete contexts[c];
+	}
+
+	return done ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,590 @@
+/*
+ * ForegroundKernel.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: Ulisse Bordignon, Nicola Chinellato
+ */
+
+#include "ForegroundKernel.h"
+#include "OccupancyKernel.h"
+
+#include <stdint.h>
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define FOREGROUND_X86
+#define FOREGROUND_AVX2_TARGET __attribute__((target("avx2")))
+#include <immintrin.h>
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#define FOREGROUND_X86
+#define FOREGROUND_AVX2_TARGET
+#include <immintrin.h>
+#endif
+
+using namespace std;
+using namespace cv;
+
+namespace nl_uu_science_gmt
+{
+
+int ForegroundKernel::_sdiv_table[256];
+int ForegroundKernel::_hdiv_table[256];
+bool ForegroundKernel::_avx2 = false;
+
+ForegroundKernel::ForegroundKernel() :
+		_h_threshold(-1), _s_threshold(-1), _v_threshold(-1), _pool(NULL)
+{
+	initTables();
+
+	setThresholds(0, 0, 0);
+	setAdaptation(8, 2.5f);
+}
+
+/**
+ * Fill the tables before their first use: the first caller fills them, concurrent callers wait
+ * for it and later ones return right away
+ */
+void ForegroundKernel::initTables()
+{
+	static const bool filled = fillTables();
+	(void) filled;
+}
+
+/**
+ * The reciprocal tables of OpenCV's 8 bit BGR to HSV conversion (hue range 180),
+ * and whether the CPU runs the AVX2 rows (the occupancy kernels detect it)
+ */
+bool ForegroundKernel::fillTables()
+{
+#ifdef FOREGROUND_X86
+	_avx2 = OccupancyKernel::detect() != OccupancyKernel::SCALAR;
+#endif
+
+	_sdiv_table[0] = _hdiv_table[0] = 0;
+	for (int i = 1; i < 256; ++i)
+	{
+		_sdiv_table[i] = saturate_cast<int>((255 << HSV_SHIFT) / (1. * i));
+		_hdiv_table[i] = saturate_cast<int>((HUE_RANGE << HSV_SHIFT) / (6. * i));
+	}
+	return true;
+}
+
+namespace
+{
+
+/**
+ * BGR to HSV, bit-identical to cvtColor(CV_BGR2HSV)
+ */
+inline void toHsv(const uchar* bgr, const int* sdiv_table, const int* hdiv_table, int &h, int &s, int &v)
+{
+	const int shift = 12;
+	const int round = 1 << (shift - 1);
+	const int b = bgr[0], g = bgr[1], r = bgr[2];
+
+	v = std::max(b, std::max(g, r));
+	const int diff = v - std::min(b, std::min(g, r));
+	const int vr = v == r ? -1 : 0;
+	const int vg = v == g ? -1 : 0;
+
+	s = (diff * sdiv_table[v] + round) >> shift;
+	h = (vr & (g - b)) + (~vr & ((vg & (b - r + 2 * diff)) + ((~vg) & (r - g + 4 * diff))));
+	h = (h * hdiv_table[diff] + round) >> shift;
+	h += h < 0 ? 180 : 0;
+	h = saturate_cast<uchar>(h);
+}
+
+/**
+ * Distance between two hues around the hue circle
+ */
+inline int hueDistance(int h, int bh)
+{
+	const int d = abs(h - bh);
+	return std::max(0, std::min(d, 180 - d));
+}
+
+#ifdef FOREGROUND_X86
+/**
+ * toHsv() of the 8 BGR pixels at 'bgr', one pixel per 32 bit lane; reads 28 bytes
+ */
+FOREGROUND_AVX2_TARGET
+inline void toHsvAvx2(const uchar* bgr, const int* sdiv_table, const int* hdiv_table, __m256i &h, __m256i &s, __m256i &v)
+{
+	// Pixels 0-3 in the low half, 4-7 in the high half, then every channel byte into its own lane
+	const __m256i pixels = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*) bgr)),
+		_mm_loadu_si128((const __m128i*) (bgr + 12)), 1);
+	const __m256i b = _mm256_shuffle_epi8(pixels, _mm256_setr_epi8(0, -1, -1, -1, 3, -1, -1, -1, 6, -1, -1, -1, 9, -1, -1, -1,
+		0, -1, -1, -1, 3, -1, -1, -1, 6, -1, -1, -1, 9, -1, -1, -1));
+	const __m256i g = _mm256_shuffle_epi8(pixels, _mm256_setr_epi8(1, -1, -1, -1, 4, -1, -1, -1, 7, -1, -1, -1, 10, -1, -1, -1,
+		1, -1, -1, -1, 4, -1, -1, -1, 7, -1, -1, -1, 10, -1, -1, -1));
+	const __m256i r = _mm256_shuffle_epi8(pixels, _mm256_setr_epi8(2, -1, -1, -1, 5, -1, -1, -1, 8, -1, -1, -1, 11, -1, -1, -1,
+		2, -1, -1, -1, 5, -1, -1, -1, 8, -1, -1, -1, 11, -1, -1, -1));
+
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i round = _mm256_set1_epi32(1 << 11);
+
+	v = _mm256_max_epi32(b, _mm256_max_epi32(g, r));
+	const __m256i diff = _mm256_sub_epi32(v, _mm256_min_epi32(b, _mm256_min_epi32(g, r)));
+	const __m256i vr = _mm256_cmpeq_epi32(v, r);
+	const __m256i vg = _mm256_cmpeq_epi32(v, g);
+
+	// The reciprocals are the only lookups left, gathered
+	s = _mm256_srai_epi32(_mm256_add_epi32(_mm256_mullo_epi32(diff, _mm256_i32gather_epi32(sdiv_table, v, 4)), round), 12);
+
+	const __m256i h_vg = _mm256_add_epi32(_mm256_sub_epi32(b, r), _mm256_slli_epi32(diff, 1));
+	const __m256i h_vb = _mm256_add_epi32(_mm256_sub_epi32(r, g), _mm256_slli_epi32(diff, 2));
+	h = _mm256_or_si256(_mm256_and_si256(vr, _mm256_sub_epi32(g, b)),
+		_mm256_andnot_si256(vr, _mm256_or_si256(_mm256_and_si256(vg, h_vg), _mm256_andnot_si256(vg, h_vb))));
+	h = _mm256_srai_epi32(_mm256_add_epi32(_mm256_mullo_epi32(h, _mm256_i32gather_epi32(hdiv_table, diff, 4)), round), 12);
+	h = _mm256_add_epi32(h, _mm256_and_si256(_mm256_cmpgt_epi32(zero, h), _mm256_set1_epi32(180)));
+	h = _mm256_min_epi32(_mm256_max_epi32(h, zero), _mm256_set1_epi32(255));
+}
+
+/**
+ * The channel differences (dH, dS, dV) of the 8 BGR pixels at 'bgr' with the 8 (H, S, V, 0) pixels at 'bg'
+ */
+FOREGROUND_AVX2_TARGET
+inline void differenceAvx2(const uchar* bgr, const uchar* bg, const int* sdiv_table, const int* hdiv_table,
+	__m256i &dh, __m256i &ds, __m256i &dv)
+{
+	__m256i h, s, v;
+	toHsvAvx2(bgr, sdiv_table, hdiv_table, h, s, v);
+
+	const __m256i background = _mm256_loadu_si256((const __m256i*) bg);
+	const __m256i byte = _mm256_set1_epi32(0xFF);
+	const __m256i d = _mm256_abs_epi32(_mm256_sub_epi32(h, _mm256_and_si256(background, byte)));
+	dh = _mm256_max_epi32(_mm256_setzero_si256(), _mm256_min_epi32(d, _mm256_sub_epi32(_mm256_set1_epi32(180), d)));
+	ds = _mm256_abs_epi32(_mm256_sub_epi32(s, _mm256_and_si256(_mm256_srli_epi32(background, 8), byte)));
+	dv = _mm256_abs_epi32(_mm256_sub_epi32(v, _mm256_and_si256(_mm256_srli_epi32(background, 16), byte)));
+}
+
+/**
+ * Store the 8 lanes of a comparison mask as 8 bytes of 0 or 255
+ */
+FOREGROUND_AVX2_TARGET
+inline void storeMaskAvx2(__m256i mask, uchar* dst)
+{
+	const __m256i words = _mm256_packs_epi32(mask, mask);
+	const __m256i bytes = _mm256_packs_epi16(words, words);
+	const int low = _mm_cvtsi128_si32(_mm256_castsi256_si128(bytes));
+	const int high = _mm_cvtsi128_si32(_mm256_extracti128_si256(bytes, 1));
+	memcpy(dst, &low, 4);
+	memcpy(dst + 4, &high, 4);
+}
+
+/**
+ * The pass tables as comparisons: (dH > h && dS > s) || dV > v
+ */
+FOREGROUND_AVX2_TARGET
+inline void thresholdAvx2(__m256i dh, __m256i ds, __m256i dv, const __m256i* thresholds, uchar* dst)
+{
+	storeMaskAvx2(_mm256_or_si256(
+		_mm256_and_si256(_mm256_cmpgt_epi32(dh, thresholds[0]), _mm256_cmpgt_epi32(ds, thresholds[1])),
+		_mm256_cmpgt_epi32(dv, thresholds[2])), dst);
+}
+
+/**
+ * Load the 8 (H, S, V, pad) pixels of 16 bit model statistics at 'model', one pixel per 32 bit lane:
+ * 'low' holds H | S << 16 and 'high' V | pad << 16
+ */
+FOREGROUND_AVX2_TARGET
+inline void loadModelAvx2(const ushort* model, __m256i &low, __m256i &high)
+{
+	const __m256i first = _mm256_loadu_si256((const __m256i*) model);
+	const __m256i second = _mm256_loadu_si256((const __m256i*) (model + 16));
+
+	// Pixels 0, 1, 4, 5 and 2, 3, 6, 7, then the even and odd 32 bit halves of every pixel
+	const __m256 a = _mm256_castsi256_ps(_mm256_permute2x128_si256(first, second, 0x20));
+	const __m256 b = _mm256_castsi256_ps(_mm256_permute2x128_si256(first, second, 0x31));
+	low = _mm256_castps_si256(_mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+	high = _mm256_castps_si256(_mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+}
+
+/**
+ * The inverse of loadModelAvx2()
+ */
+FOREGROUND_AVX2_TARGET
+inline void storeModelAvx2(ushort* model, __m256i low, __m256i high)
+{
+	const __m256i a = _mm256_unpacklo_epi32(low, high);
+	const __m256i b = _mm256_unpackhi_epi32(low, high);
+	_mm256_storeu_si256((__m256i*) model, _mm256_permute2x128_si256(a, b, 0x20));
+	_mm256_storeu_si256((__m256i*) (model + 16), _mm256_permute2x128_si256(a, b, 0x31));
+}
+
+/**
+ * The rows of subtract(), difference() and threshold() 8 pixels at a time,
+ * they return the amount of pixels done and leave the rest of the row to the caller
+ */
+FOREGROUND_AVX2_TARGET
+int subtractRowAvx2(const uchar* src, const uchar* bg, uchar* dst, int cols, const int* sdiv_table, const int* hdiv_table,
+	int h_threshold, int s_threshold, int v_threshold)
+{
+	const __m256i thresholds[3] = { _mm256_set1_epi32(h_threshold), _mm256_set1_epi32(s_threshold), _mm256_set1_epi32(
+		v_threshold) };
+
+	// The BGR loads read 4 bytes beyond the 8 pixels
+	int x = 0;
+	for (; x + 10 <= cols; x += 8)
+	{
+		__m256i dh, ds, dv;
+		differenceAvx2(src + 3 * x, bg + 4 * x, sdiv_table, hdiv_table, dh, ds, dv);
+		thresholdAvx2(dh, ds, dv, thresholds, dst + x);
+	}
+	return x;
+}
+
+FOREGROUND_AVX2_TARGET
+int differenceRowAvx2(const uchar* src, const uchar* bg, uchar* dst, int cols, const int* sdiv_table, const int* hdiv_table)
+{
+	int x = 0;
+	for (; x + 10 <= cols; x += 8)
+	{
+		__m256i dh, ds, dv;
+		differenceAvx2(src + 3 * x, bg + 4 * x, sdiv_table, hdiv_table, dh, ds, dv);
+		const __m256i packed = _mm256_or_si256(dh, _mm256_or_si256(_mm256_slli_epi32(ds, 8), _mm256_slli_epi32(dv, 16)));
+		_mm256_storeu_si256((__m256i*) (dst + 4 * x), packed);
+	}
+	return x;
+}
+
+FOREGROUND_AVX2_TARGET
+int thresholdRowAvx2(const uchar* src, uchar* dst, int cols, int h_threshold, int s_threshold, int v_threshold)
+{
+	const __m256i thresholds[3] = { _mm256_set1_epi32(h_threshold), _mm256_set1_epi32(s_threshold), _mm256_set1_epi32(
+		v_threshold) };
+	const __m256i byte = _mm256_set1_epi32(0xFF);
+
+	int x = 0;
+	for (; x + 8 <= cols; x += 8)
+	{
+		const __m256i differences = _mm256_loadu_si256((const __m256i*) (src + 4 * x));
+		thresholdAvx2(_mm256_and_si256(differences, byte), _mm256_and_si256(_mm256_srli_epi32(differences, 8), byte),
+			_mm256_and_si256(_mm256_srli_epi32(differences, 16), byte), thresholds, dst + x);
+	}
+	return x;
+}
+
+/**
+ * The row of subtractAdaptive() 8 pixels at a time: the model's 16 bit statistics are widened to 32 bit
+ * lanes, as a difference with the mean takes 17 bits, and narrowed again when they're stored
+ */
+FOREGROUND_AVX2_TARGET
+int subtractAdaptiveRowAvx2(const uchar* src, ushort* mean, ushort* variance, uchar* dst, int cols, const int* sdiv_table,
+	const int* hdiv_table, const int* thresholds, int deviations_q4, int learning_shift, bool learn)
+{
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i word = _mm256_set1_epi32(0xFFFF);
+	const __m256i hue_q8 = _mm256_set1_epi32(180 << 8);
+	const __m256i half_hue_q8 = _mm256_set1_epi32(90 << 8);
+	const __m256i max_difference = _mm256_set1_epi32(255);
+	const __m256i deviations = _mm256_set1_epi32(deviations_q4);
+	const __m256i min_variance = _mm256_set1_epi32(4);
+	const __m256i channel_thresholds[3] = { _mm256_set1_epi32(thresholds[0]), _mm256_set1_epi32(thresholds[1]),
+		_mm256_set1_epi32(thresholds[2]) };
+
+	int x = 0;
+	for (; x + 10 <= cols; x += 8)
+	{
+		__m256i hsv[3];
+		toHsvAvx2(src + 3 * x, sdiv_table, hdiv_table, hsv[0], hsv[1], hsv[2]);
+
+		__m256i mean_low, mean_high, variance_low, variance_high;
+		loadModelAvx2(mean + 4 * x, mean_low, mean_high);
+		loadModelAvx2(variance + 4 * x, variance_low, variance_high);
+		const __m256i means[3] = { _mm256_and_si256(mean_low, word), _mm256_srli_epi32(mean_low, 16),
+			_mm256_and_si256(mean_high, word) };
+		const __m256i variances[3] = { _mm256_and_si256(variance_low, word), _mm256_srli_epi32(variance_low, 16),
+			_mm256_and_si256(variance_high, word) };
+
+		// Signed differences with the mean, hue the short way around the circle
+		__m256i d[3];
+		for (int c = 0; c < 3; ++c)
+			d[c] = _mm256_sub_epi32(_mm256_slli_epi32(hsv[c], 8), means[c]);
+		d[0] = _mm256_sub_epi32(d[0], _mm256_and_si256(_mm256_cmpgt_epi32(d[0], half_hue_q8), hue_q8));
+		d[0] = _mm256_add_epi32(d[0], _mm256_and_si256(_mm256_cmpgt_epi32(_mm256_sub_epi32(zero, half_hue_q8), d[0]), hue_q8));
+
+		__m256i pass[3];
+		for (int c = 0; c < 3; ++c)
+		{
+			const __m256i a = _mm256_min_epi32(_mm256_srli_epi32(_mm256_abs_epi32(d[c]), 8), max_difference);
+			const __m256i deviating = _mm256_cmpgt_epi32(_mm256_slli_epi32(_mm256_mullo_epi32(a, a), 4),
+				_mm256_mullo_epi32(deviations, variances[c]));
+			pass[c] = _mm256_and_si256(deviating, _mm256_cmpgt_epi32(a, channel_thresholds[c]));
+		}
+
+		const __m256i fg = _mm256_or_si256(_mm256_and_si256(pass[0], pass[1]), pass[2]);
+		storeMaskAvx2(fg, dst + x);
+
+		if (!learn) continue;
+
+		// Per lane shifts: foreground pixels learn 16 times slower
+		const __m256i shift = _mm256_add_epi32(_mm256_set1_epi32(learning_shift), _mm256_and_si256(fg, _mm256_set1_epi32(4)));
+		__m256i m[3], v[3];
+		for (int c = 0; c < 3; ++c)
+		{
+			m[c] = _mm256_add_epi32(means[c], _mm256_srav_epi32(d[c], shift));
+
+			const __m256i a = _mm256_srli_epi32(_mm256_abs_epi32(d[c]), 4);
+			const __m256i square = _mm256_srli_epi32(_mm256_mullo_epi32(a, a), 8);
+			v[c] = _mm256_max_epi32(_mm256_add_epi32(variances[c], _mm256_srav_epi32(_mm256_sub_epi32(square, variances[c]), shift)),
+				min_variance);
+		}
+		m[0] = _mm256_add_epi32(m[0], _mm256_and_si256(_mm256_cmpgt_epi32(zero, m[0]), hue_q8));
+		m[0] = _mm256_sub_epi32(m[0], _mm256_andnot_si256(_mm256_cmpgt_epi32(hue_q8, m[0]), hue_q8));
+
+		// The pads are kept as they are
+		storeModelAvx2(mean + 4 * x, _mm256_or_si256(_mm256_and_si256(m[0], word), _mm256_slli_epi32(m[1], 16)),
+			_mm256_or_si256(_mm256_and_si256(m[2], word), _mm256_andnot_si256(word, mean_high)));
+		storeModelAvx2(variance + 4 * x, _mm256_or_si256(_mm256_and_si256(v[0], word), _mm256_slli_epi32(v[1], 16)),
+			_mm256_or_si256(_mm256_and_si256(v[2], word), _mm256_andnot_si256(word, variance_high)));
+	}
+	return x;
+}
+#endif
+
+}
+
+void ForegroundKernel::buildPass(int threshold, uchar* pass)
+{
+	for (int d = 0; d < 256; ++d)
+		pass[d] = d > threshold ? 255 : 0;
+}
+
+/**
+ * Set the H, S and V thresholds, only the tables of the changed thresholds are rebuilt
+ */
+void ForegroundKernel::setThresholds(int h_threshold, int s_threshold, int v_threshold)
+{
+	if (h_threshold != _h_threshold) buildPass(h_threshold, _h_pass);
+	if (s_threshold != _s_threshold) buildPass(s_threshold, _s_pass);
+	if (v_threshold != _v_threshold) buildPass(v_threshold, _v_pass);
+
+	_h_threshold = h_threshold;
+	_s_threshold = s_threshold;
+	_v_threshold = v_threshold;
+}
+
+/**
+ * Adaptive background: learn at a rate of 2^-learning_shift per frame, a channel differs
+ * from the background if it lies more than 'deviations' standard deviations from the mean
+ */
+void ForegroundKernel::setAdaptation(int learning_shift, float deviations)
+{
+	_learning_shift = std::max(1, std::min(learning_shift, 15));
+	_deviations_q4 = cvRound(deviations * deviations * 16);
+}
+
+/**
+ * Start a running background model from an interleaved HSV background (see toBackground())
+ */
+void ForegroundKernel::initModel(const Mat &background, BackgroundModel &model)
+{
+	assert(background.type() == CV_8UC4);
+	background.convertTo(model.mean, CV_16UC4, 256);
+	model.variance.create(background.size(), CV_16UC4);
+	model.variance.setTo(Scalar::all(MIN_VARIANCE));
+}
+
+/**
+ * Convert a BGR background image to the interleaved (H, S, V, 0) background the kernel compares with
+ */
+void ForegroundKernel::toBackground(const Mat &image, Mat &background)
+{
+	assert(image.type() == CV_8UC3);
+	initTables();
+
+	background.create(image.size(), CV_8UC4);
+	for (int y = 0; y < image.rows; ++y)
+	{
+		const uchar* src = image.ptr<uchar>(y);
+		uchar* dst = background.ptr<uchar>(y);
+		for (int x = 0; x < image.cols; ++x, src += 3, dst += 4)
+		{
+			int h, s, v;
+			toHsv(src, _sdiv_table, _hdiv_table, h, s, v);
+			dst[0] = (uchar) h;
+			dst[1] = (uchar) s;
+			dst[2] = (uchar) v;
+			dst[3] = 0;
+		}
+	}
+}
+
+/**
+ * Subtract the background from a BGR frame, the result is written into 'foreground',
+ * which is only (re)allocated if it doesn't have the frame's size
+ */
+void ForegroundKernel::subtract(const Mat &frame, const Mat &background, Mat &foreground) const
+{
+	assert(frame.type() == CV_8UC3 && background.type() == CV_8UC4 && background.size() == frame.size());
+	foreground.create(frame.size(), CV_8U);
+
+	const int rows = frame.rows;
+	const int cols = frame.cols;
+
+	parallelFor(_pool, 0, rows, [&](int first, int last)
+	{
+		for (int y = first; y < last; ++y)
+		{
+			const uchar* src = frame.ptr<uchar>(y);
+			const uchar* bg = background.ptr<uchar>(y);
+			uchar* dst = foreground.ptr<uchar>(y);
+
+			int x = 0;
+#ifdef FOREGROUND_X86
+			if (_avx2)
+				x = subtractRowAvx2(src, bg, dst, cols, _sdiv_table, _hdiv_table, _h_threshold, _s_threshold, _v_threshold);
+#endif
+			for (src += 3 * x, bg += 4 * x; x < cols; ++x, src += 3, bg += 4)
+			{
+				int h, s, v;
+				toHsv(src, _sdiv_table, _hdiv_table, h, s, v);
+				dst[x] = (_h_pass[hueDistance(h, bg[0])] & _s_pass[abs(s - bg[1])]) | _v_pass[abs(v - bg[2])];
+			}
+		}
+	}, 16);
+}
+
+/**
+ * The per pixel channel differences (dH, dS, dV, 0) of a frame with the background, thresholding
+ * these again is all it takes to update the foreground of an unchanged frame
+ */
+void ForegroundKernel::difference(const Mat &frame, const Mat &background, Mat &differences, ThreadPool* pool)
+{
+	assert(frame.type() == CV_8UC3 && background.type() == CV_8UC4 && background.size() == frame.size());
+	differences.create(frame.size(), CV_8UC4);
+
+	initTables();
+
+	const int rows = frame.rows;
+	const int cols = frame.cols;
+
+	parallelFor(pool, 0, rows, [&](int first, int last)
+	{
+		for (int y = first; y < last; ++y)
+		{
+			const uchar* src = frame.ptr<uchar>(y);
+			const uchar* bg = background.ptr<uchar>(y);
+			uchar* dst = differences.ptr<uchar>(y);
+
+			int x = 0;
+#ifdef FOREGROUND_X86
+			if (_avx2) x = differenceRowAvx2(src, bg, dst, cols, _sdiv_table, _hdiv_table);
+#endif
+			for (src += 3 * x, bg += 4 * x, dst += 4 * x; x < cols; ++x, src += 3, bg += 4, dst += 4)
+			{
+				int h, s, v;
+				toHsv(src, _sdiv_table, _hdiv_table, h, s, v);
+				dst[0] = (uchar) hueDistance(h, bg[0]);
+				dst[1] = (uchar) abs(s - bg[1]);
+				dst[2] = (uchar) abs(v - bg[2]);
+				dst[3] = 0;
+			}
+		}
+	}, 16);
+}
+
+/**
+ * Threshold the channel differences from difference() into 'foreground'
+ */
+void ForegroundKernel::threshold(const Mat &differences, Mat &foreground) const
+{
+	assert(differences.type() == CV_8UC4);
+	foreground.create(differences.size(), CV_8U);
+
+	const int rows = differences.rows;
+	const int cols = differences.cols;
+
+	parallelFor(_pool, 0, rows, [&](int first, int last)
+	{
+		for (int y = first; y < last; ++y)
+		{
+			const uchar* src = differences.ptr<uchar>(y);
+			uchar* dst = foreground.ptr<uchar>(y);
+
+			int x = 0;
+#ifdef FOREGROUND_X86
+			if (_avx2) x = thresholdRowAvx2(src, dst, cols, _h_threshold, _s_threshold, _v_threshold);
+#endif
+			for (src += 4 * x; x < cols; ++x, src += 4)
+				dst[x] = (_h_pass[src[0]] & _s_pass[src[1]]) | _v_pass[src[2]];
+		}
+	}, 16);
+}
+
+/**
+ * Subtract the running background model from a BGR frame and (if 'learn') let the model follow the frame:
+ * background pixels at the learning rate, foreground pixels 16 times slower so objects that stay put
+ * are eventually absorbed
+ */
+void ForegroundKernel::subtractAdaptive(const Mat &frame, BackgroundModel &model, Mat &foreground, bool learn) const
+{
+	assert(frame.type() == CV_8UC3 && model.mean.type() == CV_16UC4 && model.mean.size() == frame.size());
+	foreground.create(frame.size(), CV_8U);
+
+	const int rows = frame.rows;
+	const int cols = frame.cols;
+	const int hue_q8 = HUE_RANGE << 8;
+	const int deviations_q4 = _deviations_q4;
+	const int thresholds[3] = { _h_threshold, _s_threshold, _v_threshold };
+
+	parallelFor(_pool, 0, rows, [&](int first, int last)
+	{
+		for (int y = first; y < last; ++y)
+		{
+			const uchar* src = frame.ptr<uchar>(y);
+			ushort* mean = model.mean.ptr<ushort>(y);
+			ushort* variance = model.variance.ptr<ushort>(y);
+			uchar* dst = foreground.ptr<uchar>(y);
+
+			int x = 0;
+#ifdef FOREGROUND_X86
+			if (_avx2)
+				x = subtractAdaptiveRowAvx2(src, mean, variance, dst, cols, _sdiv_table, _hdiv_table, thresholds, deviations_q4,
+					_learning_shift, learn);
+#endif
+			for (src += 3 * x, mean += 4 * x, variance += 4 * x; x < cols; ++x, src += 3, mean += 4, variance += 4)
+			{
+				int hsv[3];
+				toHsv(src, _sdiv_table, _hdiv_table, hsv[0], hsv[1], hsv[2]);
+
+				// Signed differences with the mean (8 fractional bits), hue the short way around the circle
+				int d[3];
+				for (int c = 0; c < 3; ++c)
+					d[c] = (hsv[c] << 8) - mean[c];
+				if (d[0] > hue_q8 / 2) d[0] -= hue_q8;
+				else if (d[0] < -hue_q8 / 2) d[0] += hue_q8;
+
+				uchar pass[3];
+				const uchar* tables[3] = { _h_pass, _s_pass, _v_pass };
+				for (int c = 0; c < 3; ++c)
+				{
+					const int a = std::min(abs(d[c]) >> 8, 255);
+					pass[c] = (a * a * 16 > deviations_q4 * variance[c]) ? tables[c][a] : 0;
+				}
+
+				const uchar fg = (pass[0] & pass[1]) | pass[2];
+				dst[x] = fg;
+
+				if (!learn) continue;
+
+				const int shift = fg ? _learning_shift + 4 : _learning_shift;
+				for (int c = 0; c < 3; ++c)
+				{
+					int m = mean[c] + (d[c] >> shift);
+					if (c == 0) m = m < 0 ? m + hue_q8 : (m >= hue_q8 ? m - hue_q8 : m);
+					mean[c] = (ushort) m;
+
+					const int a = abs(d[c]) >> 4;  // 4 fractional bits, a * a has 8
+					const int v = variance[c] + (((a * a >> 8) - variance[c]) >> shift);
+					variance[c] = (ushort) std::max(v, (int) MIN_VARIANCE);
+				}
+			}
+		}
+	}, 16);
+}
+
+} /* namespace nl_uu_science_gmt */
@@ -0,0 +1,79 @@
+/*
+ * FrameCache.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: Ulisse Bordignon, Nicola Chinellato
+ */
+
+#include "FrameCache.h"
+
+using namespace std;
+using namespace cv;
+
+namespace nl_uu_science_gmt
+{
+
+FrameCache::FrameCache(size_t budget) :
+		_budget(budget), _size(0)
+{
+}
+
+/**
+ * Copy the cached frame into 'frame' (reusing its buffer), returns false on a miss
+ */
+bool FrameCache::get(int camera, int frame_number, Mat &frame)
+{
+	lock_guard<mutex> lock(_mutex);
+
+	const unordered_map<uint64_t, list<Entry>::iterator>::iterator found = _lookup.find(getKey(camera, frame_number));
+	if (found == _lookup.end()) return false;
+
+	_entries.splice(_entries.begin(), _entries, found->second);
+	found->second->second.copyTo(frame);
+	return true;
+}
+
+/**
+ * Store a copy of the frame, evicting the least recently used frames that don't fit the budget,
+ * the copy reuses the buffer of the last evicted frame if it has the same size
+ */
+void FrameCache::put(int camera, int frame_number, const Mat &frame)
+{
+	const size_t bytes = frame.total() * frame.elemSize();
+	if (frame.empty() || bytes > _budget) return;
+
+	lock_guard<mutex> lock(_mutex);
+
+	const uint64_t key = getKey(camera, frame_number);
+	const unordered_map<uint64_t, list<Entry>::iterator>::iterator found = _lookup.find(key);
+	if (found != _lookup.end())
+	{
+		_entries.splice(_entries.begin(), _entries, found->second);
+		return;
+	}
+
+	Mat buffer;
+	while (_size + bytes > _budget && !_entries.empty())
+	{
+		Entry &oldest = _entries.back();
+		_size -= oldest.second.total() * oldest.second.elemSize();
+		_lookup.erase(oldest.first);
+		buffer = oldest.second;  // the cache holds the only reference, get() hands out copies
+		_entries.pop_back();
+	}
+
+	frame.copyTo(buffer);
+	_entries.push_front(Entry(key, buffer));
+	_lookup[key] = _entries.begin();
+	_size += bytes;
+}
+
+void FrameCache::clear()
+{
+	lock_guard<mutex> lock(_mutex);
+	_entries.clear();
+	_lookup.clear();
+	_size = 0;
+}
+
+} /* namespace nl_uu_science_gmt */
@@ -23,6 +23,9 @@ namespace nl_uu_science_gmt
 	const string General::BackgroundVideoFile = "background.avi";
 	const string General::BackgroundImageFile = "background.png";
 	const string General::VideoFile = "video.avi";
+	const string General::VideoIndexFile = "video_index.xml";
+	const string General::ReconstructionFile = "reconstruction.bin";
+	const string General::TrackFile = "track.txt";
 	const string General::IntrinsicsFile = "intrinsics.xml";
 	const string General::CheckerboadCorners = "boardcorners.xml";
 	const string General::ConfigFile = "config.xml";
@@ -40,6 +43,21 @@ namespace nl_uu_science_gmt
 		return sqrt(pow(p1.x - p2.x, 2) + pow(p1.y - p2.y, 2));
 	}
 
+	/**
+	* 64 bit FNV-1a hash of a block of memory, pass a previous hash as seed to chain blocks
+	*/
+	uint64_t General::hash(const void* data, size_t size, uint64_t seed)
+	{
+		const unsigned char* bytes = (const unsigned char*)data;
+		uint64_t h = seed;
+		for (size_t i = 0; i < size; ++i)
+		{
+			h ^= bytes[i];
+			h *= 1099511628211ULL;
+		}
+		return h;
+	}
+
 	void General::popupCallback(int event, int x, int y, int, void* param) {
 		int* key = (int*)param;
 		if (event != EVENT_LBUTTONDOWN)
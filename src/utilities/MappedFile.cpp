@@ -0,0 +1,118 @@
+/*
+ * MappedFile.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: Ulisse Bordignon, Nicola Chinellato
+ */
+
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+namespace nl_uu_science_gmt
+{
+
+MappedFile::MappedFile() :
+		_data(NULL), _size(0)
+{
+#ifdef _WIN32
+	_file = INVALID_HANDLE_VALUE;
+	_mapping = NULL;
+#else
+	_fd = -1;
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+/**
+ * Map the whole file read-only into memory, returns false if that's not possible
+ */
+bool MappedFile::open(const string &filename)
+{
+	close();
+
+#ifdef _WIN32
+	_file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+			FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (_file == INVALID_HANDLE_VALUE) return false;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(_file, &size) || size.QuadPart == 0)
+	{
+		close();
+		return false;
+	}
+	_size = (size_t) size.QuadPart;
+
+	_mapping = CreateFileMappingA(_file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (_mapping == NULL)
+	{
+		close();
+		return false;
+	}
+
+	_data = (const char*) MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0);
+	if (_data == NULL)
+	{
+		close();
+		return false;
+	}
+#else
+	_fd = ::open(filename.c_str(), O_RDONLY);
+	if (_fd < 0) return false;
+
+	struct stat st;
+	if (fstat(_fd, &st) != 0 || st.st_size == 0)
+	{
+		close();
+		return false;
+	}
+	_size = (size_t) st.st_size;
+
+	void* data = mmap(NULL, _size, PROT_READ, MAP_SHARED, _fd, 0);
+	if (data == MAP_FAILED)
+	{
+		close();
+		return false;
+	}
+	_data = (const char*) data;
+#endif
+
+	return true;
+}
+
+/**
+ * Unmap the file and release its handles
+ */
+void MappedFile::close()
+{
+#ifdef _WIN32
+	if (_data != NULL) UnmapViewOfFile(_data);
+	if (_mapping != NULL) CloseHandle(_mapping);
+	if (_file != INVALID_HANDLE_VALUE) CloseHandle(_file);
+	_mapping = NULL;
+	_file = INVALID_HANDLE_VALUE;
+#else
+	if (_data != NULL) munmap((void*) _data, _size);
+	if (_fd >= 0) ::close(_fd);
+	_fd = -1;
+#endif
+
+	_data = NULL;
+	_size = 0;
+}
+
+} /* namespace nl_uu_science_gmt */
@@ -0,0 +1,292 @@
+/*
+ * Morphology.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: Ulisse Bordignon, Nicola Chinellato
+ */
+
+#include "Morphology.h"
+
+#include <algorithm>
+#include <cassert>
+#include <vector>
+
+using namespace std;
+using namespace cv;
+
+namespace nl_uu_science_gmt
+{
+
+namespace
+{
+
+template<bool MAX> inline uchar extremum(uchar a, uchar b)
+{
+	return MAX ? std::max(a, b) : std::min(a, b);
+}
+
+// The value that doesn't change an extremum, used for the pixels outside the image
+template<bool MAX> inline uchar identity()
+{
+	return MAX ? 0 : 255;
+}
+
+}
+
+/**
+ * Running extremum over a window of 2 * radius + 1 along every row
+ */
+template<bool MAX> void Morphology::filterRows(const Mat &src, Mat &dst, int radius)
+{
+	const int window = 2 * radius + 1;
+	const int cols = src.cols;
+	const int padded = (cols + 2 * radius + window - 1) / window * window;
+
+	parallelFor(_pool, 0, src.rows, [&](int first, int last)
+	{
+		vector<uchar> line(padded), g(padded), h(padded);
+
+		for (int y = first; y < last; ++y)
+		{
+			const uchar* in = src.ptr<uchar>(y);
+			std::fill(line.begin(), line.end(), identity<MAX>());
+			std::copy(in, in + cols, line.begin() + radius);
+
+			for (int i = 0; i < padded; ++i)
+				g[i] = i % window == 0 ? line[i] : extremum<MAX>(g[i - 1], line[i]);
+			for (int i = padded - 1; i >= 0; --i)
+				h[i] = (i % window == window - 1 || i == padded - 1) ? line[i] : extremum<MAX>(h[i + 1], line[i]);
+
+			// The window of x covers [x, x + 2 * radius] in padded coordinates
+			uchar* out = dst.ptr<uchar>(y);
+			for (int x = 0; x < cols; ++x)
+				out[x] = extremum<MAX>(h[x], g[x + 2 * radius]);
+		}
+	}, 16);
+}
+
+/**
+ * Running extremum over a window of 2 * radius + 1 along every column, computed a row at a time
+ * so the inner loops run over contiguous memory
+ */
+template<bool MAX> void Morphology::filterColumns(const Mat &src, Mat &dst, int radius)
+{
+	const int window = 2 * radius + 1;
+	const int rows = src.rows;
+	const int cols = src.cols;
+	const int padded = (rows + 2 * radius + window - 1) / window * window;
+
+	_g.create(padded, cols, CV_8U);
+	_h.create(padded, cols, CV_8U);
+
+	// Row i of the padded column is image row i - radius
+	parallelFor(_pool, 0, padded / window, [&](int first, int last)
+	{
+		for (int b = first; b < last; ++b)
+		{
+			for (int i = b * window; i < (b + 1) * window; ++i)
+			{
+				const int y = i - radius;
+				uchar* g = _g.ptr<uchar>(i);
+				if (y < 0 || y >= rows)
+				{
+					if (i % window == 0)
+						std::fill(g, g + cols, identity<MAX>());
+					else
+						std::copy(_g.ptr<uchar>(i - 1), _g.ptr<uchar>(i - 1) + cols, g);
+					continue;
+				}
+
+				const uchar* in = src.ptr<uchar>(y);
+				if (i % window == 0)
+				{
+					std::copy(in, in + cols, g);
+				}
+				else
+				{
+					const uchar* previous = _g.ptr<uchar>(i - 1);
+					for (int x = 0; x < cols; ++x)
+						g[x] = extremum<MAX>(previous[x], in[x]);
+				}
+			}
+
+			for (int i = (b + 1) * window - 1; i >= b * window; --i)
+			{
+				const int y = i - radius;
+				uchar* h = _h.ptr<uchar>(i);
+				const bool outside = y < 0 || y >= rows;
+				if (i % window == window - 1)
+				{
+					if (outside)
+						std::fill(h, h + cols, identity<MAX>());
+					else
+						std::copy(src.ptr<uchar>(y), src.ptr<uchar>(y) + cols, h);
+				}
+				else if (outside)
+				{
+					std::copy(_h.ptr<uchar>(i + 1), _h.ptr<uchar>(i + 1) + cols, h);
+				}
+				else
+				{
+					const uchar* in = src.ptr<uchar>(y);
+					const uchar* next = _h.ptr<uchar>(i + 1);
+					for (int x = 0; x < cols; ++x)
+						h[x] = extremum<MAX>(next[x], in[x]);
+				}
+			}
+		}
+	}, 1);
+
+	parallelFor(_pool, 0, rows, [&](int first, int last)
+	{
+		for (int y = first; y < last; ++y)
+		{
+			const uchar* h = _h.ptr<uchar>(y);
+			const uchar* g = _g.ptr<uchar>(y + 2 * radius);
+			uchar* out = dst.ptr<uchar>(y);
+			for (int x = 0; x < cols; ++x)
+				out[x] = extremum<MAX>(h[x], g[x]);
+		}
+	}, 16);
+}
+
+/**
+ * Erode with a square of side 2 * radius + 1, 'dst' may be 'src'
+ */
+void Morphology::erode(const Mat &src, Mat &dst, int radius)
+{
+	assert(src.type() == CV_8U);
+	dst.create(src.size(), CV_8U);
+	if (radius <= 0)
+	{
+		if (dst.data != src.data) src.copyTo(dst);
+		return;
+	}
+
+	_tmp.create(src.size(), CV_8U);
+	filterRows<false>(src, _tmp, radius);
+	filterColumns<false>(_tmp, dst, radius);
+}
+
+/**
+ * Dilate with a square of side 2 * radius + 1, 'dst' may be 'src'
+ */
+void Morphology::dilate(const Mat &src, Mat &dst, int radius)
+{
+	assert(src.type() == CV_8U);
+	dst.create(src.size(), CV_8U);
+	if (radius <= 0)
+	{
+		if (dst.data != src.data) src.copyTo(dst);
+		return;
+	}
+
+	_tmp.create(src.size(), CV_8U);
+	filterRows<true>(src, _tmp, radius);
+	filterColumns<true>(_tmp, dst, radius);
+}
+
+/**
+ * Opening (erode, then dilate) in place
+ */
+void Morphology::open(Mat &image, int radius)
+{
+	erode(image, image, radius);
+	dilate(image, image, radius);
+}
+
+/**
+ * Closing (dilate, then erode) in place
+ */
+void Morphology::close(Mat &image, int radius)
+{
+	dilate(image, image, radius);
+	erode(image, image, radius);
+}
+
+/**
+ * Extremum over OpenCV's 4x4 ellipse at its anchor (2, 2): the rows from one up to one down, 2 pixels
+ * left to 1 right, plus the single pixel 2 rows straight up. Like cv::erode and cv::dilate, both take
+ * the same (unreflected) offsets. The window is small, a direct filter beats van Herk/Gil-Werman.
+ * 'dst' may be 'src'.
+ */
+template<bool MAX> void Morphology::filterEllipse(const Mat &src, Mat &dst)
+{
+	assert(src.type() == CV_8U);
+	const int rows = src.rows;
+	const int cols = src.cols;
+	const bool in_place = dst.data == src.data;
+	dst.create(src.size(), CV_8U);
+	_tmp.create(src.size(), CV_8U);
+	if (in_place) _src.create(src.size(), CV_8U);
+
+	// Rows: 2 pixels left to 1 right, keeping the source rows for the top pixel if they'll be overwritten
+	parallelFor(_pool, 0, rows, [&](int first, int last)
+	{
+		vector<uchar> line(cols + 3, identity<MAX>());
+		for (int y = first; y < last; ++y)
+		{
+			const uchar* in = src.ptr<uchar>(y);
+			std::copy(in, in + cols, line.begin() + 2);
+			if (in_place) std::copy(in, in + cols, _src.ptr<uchar>(y));
+
+			const uchar* l = &line[0];
+			uchar* out = _tmp.ptr<uchar>(y);
+			const int n = cols;  // a local, so the loop's bound can't alias 'out'
+#ifdef _OPENMP
+#pragma omp simd
+#endif
+			for (int x = 0; x < n; ++x)
+				out[x] = extremum<MAX>(extremum<MAX>(l[x], l[x + 1]), extremum<MAX>(l[x + 2], l[x + 3]));
+		}
+	}, 16);
+
+	// Columns: one row up to one down, plus the pixel 2 rows up; rows outside the image don't take part
+	const Mat &source = in_place ? _src : src;
+	parallelFor(_pool, 0, rows, [&](int first, int last)
+	{
+		const vector<uchar> none(cols, identity<MAX>());
+		for (int y = first; y < last; ++y)
+		{
+			const uchar* above = y > 0 ? _tmp.ptr<uchar>(y - 1) : &none[0];
+			const uchar* middle = _tmp.ptr<uchar>(y);
+			const uchar* below = y + 1 < rows ? _tmp.ptr<uchar>(y + 1) : &none[0];
+			const uchar* top = y > 1 ? source.ptr<uchar>(y - 2) : &none[0];
+			uchar* out = dst.ptr<uchar>(y);
+			const int n = cols;
+#ifdef _OPENMP
+#pragma omp simd
+#endif
+			for (int x = 0; x < n; ++x)
+				out[x] = extremum<MAX>(extremum<MAX>(above[x], middle[x]), extremum<MAX>(below[x], top[x]));
+		}
+	}, 16);
+}
+
+/**
+ * 'rounds' times erode, then dilate, with the 4x4 ellipse, in place. The ellipse isn't symmetric about
+ * its anchor, so a round isn't an opening and every round changes the image: the rounds can't be
+ * merged into one larger filter.
+ */
+void Morphology::erodeDilate(Mat &image, int rounds)
+{
+	for (int r = 0; r < rounds; ++r)
+	{
+		filterEllipse<false>(image, image);
+		filterEllipse<true>(image, image);
+	}
+}
+
+/**
+ * 'rounds' times dilate, then erode, with the 4x4 ellipse, in place
+ */
+void Morphology::dilateErode(Mat &image, int rounds)
+{
+	for (int r = 0; r < rounds; ++r)
+	{
+		filterEllipse<true>(image, image);
+		filterEllipse<false>(image, image);
+	}
+}
+
+} /* namespace nl_uu_science_gmt */
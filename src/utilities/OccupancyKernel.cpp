@@ -0,0 +1,233 @@
+/*
+ * OccupancyKernel.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: Ulisse Bordignon, Nicola Chinellato
+ */
+
+#include "OccupancyKernel.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define OCCUPANCY_X86
+#define OCCUPANCY_AVX2_TARGET __attribute__((target("avx2")))
+#define OCCUPANCY_AVX512_TARGET __attribute__((target("avx512f")))
+#include <immintrin.h>
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#define OCCUPANCY_X86
+#define OCCUPANCY_AVX2_TARGET
+#define OCCUPANCY_AVX512_TARGET
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+
+// AVX-512 intrinsics need at least Visual Studio 2017
+#if defined(OCCUPANCY_X86) && (!defined(_MSC_VER) || _MSC_VER >= 1910)
+#define OCCUPANCY_AVX512
+#endif
+
+namespace nl_uu_science_gmt
+{
+
+static const uint32_t INVALID = 0xFFFFFFFF;
+static const unsigned char WHITE = 255;
+
+/**
+ * Pick the widest kernel the CPU (and OS) supports
+ */
+OccupancyKernel::Type OccupancyKernel::detect()
+{
+#if defined(OCCUPANCY_X86) && defined(__GNUC__)
+	__builtin_cpu_init();
+#ifdef OCCUPANCY_AVX512
+	if (__builtin_cpu_supports("avx512f")) return AVX512;
+#endif
+	if (__builtin_cpu_supports("avx2")) return AVX2;
+#elif defined(OCCUPANCY_X86)
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7) return SCALAR;
+
+	__cpuid(info, 1);
+	const bool osxsave = (info[2] & (1 << 27)) != 0;
+	const bool avx = (info[2] & (1 << 28)) != 0;
+	if (!osxsave || !avx) return SCALAR;
+
+	// The OS has to save the YMM (and ZMM) registers
+	const unsigned long long xcr0 = _xgetbv(0);
+	__cpuidex(info, 7, 0);
+#ifdef OCCUPANCY_AVX512
+	if ((xcr0 & 0xE6) == 0xE6 && (info[1] & (1 << 16)) != 0) return AVX512;
+#endif
+	if ((xcr0 & 0x6) == 0x6 && (info[1] & (1 << 5)) != 0) return AVX2;
+#endif
+	return SCALAR;
+}
+
+OccupancyKernel::Function OccupancyKernel::get(Type type)
+{
+	switch (type)
+	{
+#ifdef OCCUPANCY_X86
+	case AVX2:
+		return avx2;
+#ifdef OCCUPANCY_AVX512
+	case AVX512:
+		return avx512;
+#endif
+#endif
+	default:
+		return scalar;
+	}
+}
+
+const char* OccupancyKernel::getName(Type type)
+{
+	switch (type)
+	{
+	case AVX2:
+		return "AVX2";
+	case AVX512:
+		return "AVX-512";
+	default:
+		return "scalar";
+	}
+}
+
+/**
+ * Reference kernel, also handles the tails of the vectorized kernels
+ */
+size_t OccupancyKernel::scalar(const uint32_t* const * projections, const unsigned char* const * foregrounds,
+		int cameras, int begin, int end, int* out)
+{
+	size_t count = 0;
+	for (int v = begin; v < end; ++v)
+	{
+		int c = 0;
+		for (; c < cameras; ++c)
+		{
+			const uint32_t offset = projections[c][v];
+			if (offset == INVALID || foregrounds[c][offset] != WHITE) break;
+		}
+
+		if (c == cameras) out[count++] = v;
+	}
+	return count;
+}
+
+#ifdef OCCUPANCY_X86
+/**
+ * 8 voxels at a time: gather the foreground bytes per camera, AND the masks of
+ * all cameras and write out the indices of the surviving lanes
+ */
+OCCUPANCY_AVX2_TARGET
+size_t OccupancyKernel::avx2(const uint32_t* const * projections, const unsigned char* const * foregrounds,
+		int cameras, int begin, int end, int* out)
+{
+	const __m256i invalid = _mm256_set1_epi32(-1);
+	const __m256i white = _mm256_set1_epi32(WHITE);
+	const __m256i zero = _mm256_setzero_si256();
+
+	size_t count = 0;
+	int v = begin;
+	for (; v + 8 <= end; v += 8)
+	{
+		__m256i alive = invalid;
+		for (int c = 0; c < cameras; ++c)
+		{
+			const __m256i offsets = _mm256_loadu_si256((const __m256i*) (projections[c] + v));
+			const __m256i valid = _mm256_andnot_si256(_mm256_cmpeq_epi32(offsets, invalid), alive);
+			if (_mm256_testz_si256(valid, valid))
+			{
+				alive = zero;
+				break;
+			}
+
+			// Masked lanes are not read, the foreground byte is the lowest of the 4 gathered ones
+			const __m256i pixels = _mm256_mask_i32gather_epi32(zero, (const int*) foregrounds[c], offsets, valid, 1);
+			alive = _mm256_and_si256(valid, _mm256_cmpeq_epi32(_mm256_and_si256(pixels, white), white));
+			if (_mm256_testz_si256(alive, alive)) break;
+		}
+
+		unsigned int lanes = (unsigned int) _mm256_movemask_ps(_mm256_castsi256_ps(alive));
+		while (lanes != 0)
+		{
+#ifdef _MSC_VER
+			unsigned long lane;
+			_BitScanForward(&lane, lanes);
+#else
+			const int lane = __builtin_ctz(lanes);
+#endif
+			out[count++] = v + (int) lane;
+			lanes &= lanes - 1;
+		}
+	}
+
+	return count + scalar(projections, foregrounds, cameras, v, end, out + count);
+}
+
+#ifdef OCCUPANCY_AVX512
+/**
+ * 16 voxels at a time, with mask registers and a compress-store of the surviving indices
+ */
+OCCUPANCY_AVX512_TARGET
+size_t OccupancyKernel::avx512(const uint32_t* const * projections, const unsigned char* const * foregrounds,
+		int cameras, int begin, int end, int* out)
+{
+	const __m512i invalid = _mm512_set1_epi32(-1);
+	const __m512i white = _mm512_set1_epi32(WHITE);
+	const __m512i zero = _mm512_setzero_si512();
+	const __m512i lanes = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+
+	size_t count = 0;
+	int v = begin;
+	for (; v + 16 <= end; v += 16)
+	{
+		__mmask16 alive = 0xFFFF;
+		for (int c = 0; c < cameras && alive != 0; ++c)
+		{
+			const __m512i offsets = _mm512_loadu_si512((const void*) (projections[c] + v));
+			const __mmask16 valid = _mm512_mask_cmpneq_epi32_mask(alive, offsets, invalid);
+			const __m512i pixels = _mm512_mask_i32gather_epi32(zero, valid, offsets, (const void*) foregrounds[c], 1);
+			alive = _mm512_mask_cmpeq_epi32_mask(valid, _mm512_and_si512(pixels, white), white);
+		}
+
+		if (alive != 0)
+		{
+			_mm512_mask_compressstoreu_epi32(out + count, alive, _mm512_add_epi32(_mm512_set1_epi32(v), lanes));
+#ifdef _MSC_VER
+			count += __popcnt(alive);
+#else
+			count += __builtin_popcount(alive);
+#endif
+		}
+	}
+
+	return count + scalar(projections, foregrounds, cameras, v, end, out + count);
+}
+#endif
+#endif
+
+#if !defined(OCCUPANCY_X86) || !defined(OCCUPANCY_AVX512)
+/**
+ * Not available on this platform/compiler, detect() never selects it
+ */
+size_t OccupancyKernel::avx512(const uint32_t* const * projections, const unsigned char* const * foregrounds,
+		int cameras, int begin, int end, int* out)
+{
+#ifdef OCCUPANCY_X86
+	return avx2(projections, foregrounds, cameras, begin, end, out);
+#else
+	return scalar(projections, foregrounds, cameras, begin, end, out);
+#endif
+}
+#endif
+
+#ifndef OCCUPANCY_X86
+size_t OccupancyKernel::avx2(const uint32_t* const * projections, const unsigned char* const * foregrounds,
+		int cameras, int begin, int end, int* out)
+{
+	return scalar(projections, foregrounds, cameras, begin, end, out);
+}
+#endif
+
+} /* namespace nl_uu_science_gmt */
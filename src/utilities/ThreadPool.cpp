@@ -0,0 +1,295 @@
+/*
+ * ThreadPool.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: Ulisse Bordignon, Nicola Chinellato
+ */
+
+#include "ThreadPool.h"
+
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <sstream>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#elif defined _WIN32
+#include <Windows.h>
+#endif
+
+using namespace std;
+
+namespace nl_uu_science_gmt
+{
+
+namespace
+{
+
+// The pool and the worker index of the current thread, so tasks submitted by a worker go to its own deque
+thread_local const ThreadPool* current_pool = NULL;
+thread_local size_t current_worker = 0;
+
+}
+
+/**
+ * Start 'threads' workers (one per hardware thread if 0), worker t pinned to cpus[t % cpus.size()]
+ */
+ThreadPool::ThreadPool(size_t threads, const vector<int> &cpus) :
+		_cpus(cpus), _pending(0), _busy(0), _next(0), _stop(false)
+{
+	if (threads == 0) threads = std::max(1u, thread::hardware_concurrency());
+
+	for (size_t t = 0; t < threads; ++t)
+		_queues.push_back(new Queue());
+	for (size_t t = 0; t < threads; ++t)
+	{
+		_workers.push_back(thread(&ThreadPool::work, this, t));
+		if (!_cpus.empty() && !pin(_workers.back(), _cpus[t % _cpus.size()]))
+			cerr << "Unable to pin worker " << t << " to CPU " << _cpus[t % _cpus.size()] << endl;
+	}
+}
+
+/**
+ * Finish the queued tasks and stop the workers
+ */
+ThreadPool::~ThreadPool()
+{
+	{
+		lock_guard<mutex> lock(_mutex);
+		_stop = true;
+	}
+	_task_available.notify_all();
+
+	for (size_t t = 0; t < _workers.size(); ++t)
+		_workers[t].join();
+	for (size_t t = 0; t < _queues.size(); ++t)
+		delete _queues[t];
+}
+
+/**
+ * The index of the calling worker of this pool, -1 for any other thread
+ */
+int ThreadPool::getWorker() const
+{
+	return current_pool == this ? (int) current_worker : -1;
+}
+
+/**
+ * Queue a task, tasks may submit more tasks
+ */
+void ThreadPool::submit(const function<void()> &task)
+{
+	const int worker = getWorker();
+	Queue &queue = *_queues[worker >= 0 ? (size_t) worker : _next++ % _queues.size()];
+	{
+		lock_guard<mutex> lock(queue.mutex);
+		queue.tasks.push_back(task);
+	}
+
+	// Counted under the pool lock, so a worker that just found nothing can't miss it
+	{
+		lock_guard<mutex> lock(_mutex);
+		++_pending;
+	}
+	_task_available.notify_one();
+}
+
+/**
+ * Wait until all tasks, including the ones they submitted, are done
+ */
+void ThreadPool::wait()
+{
+	unique_lock<mutex> lock(_mutex);
+	_idle.wait(lock, [this]
+	{	return _pending == 0 && _busy == 0;});
+}
+
+/**
+ * Take the newest task of worker 'w', or else steal the oldest one of another worker
+ */
+bool ThreadPool::popTask(size_t w, function<void()> &task)
+{
+	for (size_t i = 0; i < _queues.size(); ++i)
+	{
+		Queue &queue = *_queues[(w + i) % _queues.size()];
+		lock_guard<mutex> lock(queue.mutex);
+		if (queue.tasks.empty()) continue;
+
+		if (i == 0)
+		{
+			task = std::move(queue.tasks.back());
+			queue.tasks.pop_back();
+		}
+		else
+		{
+			task = std::move(queue.tasks.front());
+			queue.tasks.pop_front();
+		}
+
+		// Busy before not pending, so wait() never sees both at 0 in between
+		++_busy;
+		--_pending;
+		return true;
+	}
+	return false;
+}
+
+/**
+ * Worker thread 'w': run tasks until stopped and nothing is left
+ */
+void ThreadPool::work(size_t w)
+{
+	current_pool = this;
+	current_worker = w;
+
+	function<void()> task;
+	for (;;)
+	{
+		if (popTask(w, task))
+		{
+			task();
+			task = nullptr;
+
+			if (--_busy == 0 && _pending == 0)
+			{
+				lock_guard<mutex> lock(_mutex);
+				_idle.notify_all();
+			}
+			continue;
+		}
+
+		unique_lock<mutex> lock(_mutex);
+		_task_available.wait(lock, [this]
+		{	return _stop || _pending > 0;});
+		if (_stop && _pending == 0) return;
+	}
+}
+
+/**
+ * Run body(b, e) over [begin, end) split in chunks of at least 'grain', about four per thread.
+ * Chunks are claimed in order by the caller and by helper tasks; the caller only waits for the
+ * chunks that are being run, never for tasks still queued.
+ */
+void ThreadPool::parallelFor(int begin, int end, const function<void(int, int)> &body, int grain)
+{
+	if (begin >= end) return;
+
+	const int range = end - begin;
+	const int chunks = std::max(1, std::min((int) (_workers.size() + 1) * 4, range / std::max(1, grain)));
+	if (chunks == 1 || _workers.empty())
+	{
+		body(begin, end);
+		return;
+	}
+
+	struct Loop
+	{
+		std::atomic<int> next;  // next chunk to claim
+		std::atomic<int> done;  // chunks finished
+		std::mutex mutex;
+		std::condition_variable finished;
+	};
+	shared_ptr<Loop> loop = make_shared<Loop>();
+	loop->next = 0;
+	loop->done = 0;
+
+	// The body outlives a helper that starts after the loop ended, it then finds nothing to claim
+	const function<void(int, int)>* loop_body = &body;
+	auto run_chunks = [loop, loop_body, begin, range, chunks]()
+	{
+		for (int c = loop->next++; c < chunks; c = loop->next++)
+		{
+			(*loop_body)(begin + (int) ((long long) range * c / chunks), begin + (int) ((long long) range * (c + 1) / chunks));
+			if (++loop->done == chunks)
+			{
+				lock_guard<mutex> lock(loop->mutex);
+				loop->finished.notify_all();
+			}
+		}
+	};
+
+	const int helpers = std::min((int) _workers.size(), chunks - 1);
+	for (int h = 0; h < helpers; ++h)
+		submit(run_chunks);
+
+	run_chunks();
+
+	unique_lock<mutex> lock(loop->mutex);
+	loop->finished.wait(lock, [&loop, chunks]
+	{	return loop->done == chunks;});
+}
+
+/**
+ * CPUs from a list like "0-3,8,10-11" into 'cpus', tells what's wrong with an item and returns false
+ * if one is malformed or names a CPU this machine doesn't have
+ */
+bool ThreadPool::parseCpus(const string &list, vector<int> &cpus)
+{
+	const int count = (int) thread::hardware_concurrency();  // 0 if unknown
+	cpus.clear();
+	stringstream items(list);
+	string item;
+	while (getline(items, item, ','))
+	{
+		int first, last;
+		char end;
+		if (sscanf(item.c_str(), "%d-%d%c", &first, &last, &end) != 2)
+		{
+			if (sscanf(item.c_str(), "%d%c", &first, &end) != 1)
+			{
+				cerr << "--affinity expects CPUs like 0-3,8, not: " << item << endl;
+				return false;
+			}
+			last = first;
+		}
+		if (first < 0 || last < first || (count > 0 && last >= count))
+		{
+			cerr << "--affinity expects CPUs from 0" << (count > 0 ? " to " + to_string(count - 1) : string())
+				<< " in increasing ranges, not: " << item << endl;
+			return false;
+		}
+
+		for (int cpu = first; cpu <= last; ++cpu)
+			cpus.push_back(cpu);
+	}
+	if (cpus.empty())
+	{
+		cerr << "--affinity expects at least one CPU" << endl;
+		return false;
+	}
+	return true;
+}
+
+/**
+ * Run a thread on the given CPU only
+ */
+bool ThreadPool::pin(thread &t, int cpu)
+{
+#ifdef __linux__
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	return pthread_setaffinity_np(t.native_handle(), sizeof(cpu_set_t), &set) == 0;
+#elif defined _WIN32
+	return SetThreadAffinityMask((HANDLE) t.native_handle(), (DWORD_PTR) 1 << cpu) != 0;
+#else
+	(void) t;
+	(void) cpu;
+	return false;
+#endif
+}
+
+/**
+ * Threads of OpenCV's own parallel loops; with 1 or less OpenCV runs them on the calling thread,
+ * so the pool's workers don't compete with a second set of threads
+ */
+void ThreadPool::setOpenCVThreads(int threads)
+{
+	cv::setNumThreads(std::max(0, threads));
+}
+
+} /* namespace nl_uu_science_gmt */
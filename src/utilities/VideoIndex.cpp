@@ -0,0 +1,198 @@
+/*
+ * VideoIndex.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: Ulisse Bordignon, Nicola Chinellato
+ */
+
+#include "VideoIndex.h"
+#include "General.h"
+#include "MappedFile.h"
+
+#include <opencv2/opencv.hpp>
+#include <stdint.h>
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+
+using namespace std;
+using namespace cv;
+
+namespace nl_uu_science_gmt
+{
+
+namespace
+{
+
+const uint32_t AVIIF_KEYFRAME = 0x10;
+const size_t HASHED_SIZE = 1024;  // bytes at the start and at the end of the video that identify it
+
+uint32_t readU32(const char* data)
+{
+	const unsigned char* d = (const unsigned char*) data;
+	return (uint32_t) d[0] | ((uint32_t) d[1] << 8) | ((uint32_t) d[2] << 16) | ((uint32_t) d[3] << 24);
+}
+
+}
+
+VideoIndex::VideoIndex() :
+		_video_size(0), _video_hash(0), _frames(0)
+{
+}
+
+/**
+ * Index the given video, from the cache file if it still matches the video, else from the video itself
+ * (the cache is then (re)written). The cache matches if the size and the first and last KB of the video
+ * (the AVI headers and the end of idx1) are the same.
+ */
+bool VideoIndex::open(const string &video_file, const string &cache_file)
+{
+	MappedFile video;
+	if (!video.open(video_file)) return false;
+
+	const size_t size = video.getSize();
+	const size_t hashed = std::min(size, HASHED_SIZE);
+	const uint64_t hash = General::hash(video.getData() + size - hashed, hashed, General::hash(video.getData(), hashed));
+
+	if (load(cache_file, size, hash)) return true;
+
+	if (!parse(video_file)) return false;
+	_video_hash = hash;
+	save(cache_file);
+	return true;
+}
+
+/**
+ * Read the video stream entries of the legacy AVI index (idx1), every entry is a frame
+ */
+bool VideoIndex::parse(const string &video_file)
+{
+	_frames = 0;
+	_keyframes.clear();
+
+	MappedFile video;
+	if (!video.open(video_file)) return false;
+
+	const char* data = video.getData();
+	const size_t size = video.getSize();
+	if (size < 12 || memcmp(data, "RIFF", 4) != 0 || memcmp(data + 8, "AVI ", 4) != 0) return false;
+
+	int video_stream = -1;
+	const char* index = NULL;
+	size_t index_size = 0;
+
+	// Top level chunks: find the video stream number in hdrl and the idx1 chunk
+	for (size_t offset = 12; offset + 8 <= size;)
+	{
+		const char* chunk = data + offset;
+		const size_t chunk_size = readU32(chunk + 4);
+		if (offset + 8 + chunk_size > size) break;
+
+		if (memcmp(chunk, "LIST", 4) == 0 && chunk_size >= 4 && memcmp(chunk + 8, "hdrl", 4) == 0)
+		{
+			int stream = 0;
+			for (size_t o = 12; o + 8 <= chunk_size + 8 && video_stream < 0;)
+			{
+				const char* sub = chunk + o;
+				const size_t sub_size = readU32(sub + 4);
+				if (o + 8 + sub_size > chunk_size + 8) break;
+
+				if (memcmp(sub, "LIST", 4) == 0 && sub_size >= 4 + 8 + 4 && memcmp(sub + 8, "strl", 4) == 0)
+				{
+					// The strh chunk leads every strl list, its fccType tells the stream type
+					if (memcmp(sub + 12, "strh", 4) == 0 && memcmp(sub + 20, "vids", 4) == 0) video_stream = stream;
+					++stream;
+				}
+				o += 8 + sub_size + (sub_size & 1);
+			}
+		}
+		else if (memcmp(chunk, "idx1", 4) == 0)
+		{
+			index = chunk + 8;
+			index_size = chunk_size;
+		}
+
+		offset += 8 + chunk_size + (chunk_size & 1);
+	}
+
+	if (video_stream < 0 || index == NULL)
+	{
+		cerr << "No AVI index (idx1) in: " << video_file << endl;
+		return false;
+	}
+
+	const char stream_id[2] = { (char) ('0' + video_stream / 10), (char) ('0' + video_stream % 10) };
+	for (size_t e = 0; e + 16 <= index_size; e += 16)
+	{
+		const char* entry = index + e;
+		if (entry[0] != stream_id[0] || entry[1] != stream_id[1] || entry[2] != 'd') continue;
+
+		if (readU32(entry + 4) & AVIIF_KEYFRAME) _keyframes.push_back((int) _frames);
+		++_frames;
+	}
+
+	_video_size = size;
+	return _frames > 0;
+}
+
+/**
+ * Read the cached index, fails if it doesn't belong to a video of this size and hash
+ */
+bool VideoIndex::load(const string &cache_file, size_t video_size, uint64_t video_hash)
+{
+	FileStorage fs;
+	fs.open(cache_file, FileStorage::READ);
+	if (!fs.isOpened()) return false;
+
+	double cached_size = 0;
+	string cached_hash;
+	int frames = 0;
+	fs["VideoSize"] >> cached_size;
+	fs["VideoHash"] >> cached_hash;
+	fs["Frames"] >> frames;
+	fs["Keyframes"] >> _keyframes;
+	fs.release();
+
+	// FileStorage has no 64 bit integers, the hash is stored in hex
+	stringstream hash;
+	hash << hex << video_hash;
+
+	if ((size_t) cached_size != video_size || cached_hash != hash.str() || frames <= 0 || _keyframes.empty())
+	{
+		_keyframes.clear();
+		return false;
+	}
+
+	_video_size = video_size;
+	_video_hash = video_hash;
+	_frames = frames;
+	return true;
+}
+
+void VideoIndex::save(const string &cache_file) const
+{
+	FileStorage fs;
+	fs.open(cache_file, FileStorage::WRITE);
+	if (!fs.isOpened()) return;
+
+	stringstream hash;
+	hash << hex << _video_hash;
+
+	fs << "VideoSize" << (double) _video_size;
+	fs << "VideoHash" << hash.str();
+	fs << "Frames" << (int) _frames;
+	fs << "Keyframes" << _keyframes;
+	fs.release();
+}
+
+/**
+ * The last keyframe at or before the given frame
+ */
+int VideoIndex::getKeyframe(int frame) const
+{
+	vector<int>::const_iterator keyframe = upper_bound(_keyframes.begin(), _keyframes.end(), frame);
+	return keyframe == _keyframes.begin() ? 0 : *(keyframe - 1);
+}
+
+} /* namespace nl_uu_science_gmt */